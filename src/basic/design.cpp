@@ -7,79 +7,109 @@
 #include <tuple>
 #include <vector>
 #include "../basic/netlist.h"
+#include "../utils/mmap.h"
+#include "../utils/parse.h"
 
 bool Design::readCap(const std::string& filename) {
-    FILE* inputFile = fopen(filename.c_str(), "r");
-    if (!inputFile) {
+    utils::MappedFile inputFile;
+    if (!inputFile.open(filename)) {
         std::cerr << "[ERROR] Failed to open CAP file: " << filename << std::endl;
         return false;
     }
+    const char* p = inputFile.begin();
+    const char* const end = inputFile.end();
 
-    if (fscanf(inputFile, "%d %d %d", &dimension.n_layers, &dimension.x_size, &dimension.y_size) != 3) {
+    if (!utils::parseInt(p, end, dimension.n_layers) || !utils::parseInt(p, end, dimension.x_size) ||
+        !utils::parseInt(p, end, dimension.y_size)) {
         std::cerr << "[ERROR] Failed to read dimension information from CAP file." << std::endl;
-        fclose(inputFile);
         return false;
     }
 
-    if (fscanf(inputFile, "%lf %lf", &metrics.UnitLengthWireCost, &metrics.UnitViaCost) != 2) {
+    if (!utils::parseDouble(p, end, metrics.UnitLengthWireCost) || !utils::parseDouble(p, end, metrics.UnitViaCost)) {
         std::cerr << "[ERROR] Failed to read wire and via costs." << std::endl;
-        fclose(inputFile);
         return false;
     }
     parameters.UnitViaCost = metrics.UnitViaCost;
 
     metrics.OFWeight.resize(dimension.n_layers);
     for (int i = 0; i < dimension.n_layers; ++i) {
-        if (fscanf(inputFile, "%lf", &metrics.OFWeight[i]) != 1) {
+        if (!utils::parseDouble(p, end, metrics.OFWeight[i])) {
             std::cerr << "[ERROR] Failed to read overflow weights." << std::endl;
-            fclose(inputFile);
             return false;
         }
     }
 
     dimension.hEdge.resize(dimension.x_size - 1);
     for (int& hEdge : dimension.hEdge) {
-        if (fscanf(inputFile, "%d", &hEdge) != 1) {
+        if (!utils::parseInt(p, end, hEdge)) {
             std::cerr << "[ERROR] Failed to read horizontal edges." << std::endl;
-            fclose(inputFile);
             return false;
         }
     }
 
     dimension.vEdge.resize(dimension.y_size - 1);
     for (int& vEdge : dimension.vEdge) {
-        if (fscanf(inputFile, "%d", &vEdge) != 1) {
+        if (!utils::parseInt(p, end, vEdge)) {
             std::cerr << "[ERROR] Failed to read vertical edges." << std::endl;
-            fclose(inputFile);
             return false;
         }
     }
 
-    char name[1000];
+    // Layer headers are read serially; every capacity row is located by its line boundaries
+    // so that the rows of all layers can be parsed in parallel below.
+    struct CapacityRow {
+        const char* begin;
+        const char* end;
+        double* values;
+    };
+    std::vector<CapacityRow> rows;
+    rows.reserve(static_cast<size_t>(dimension.n_layers) * dimension.y_size);
+    layers.resize(dimension.n_layers);
     for (int i = 0; i < dimension.n_layers; ++i) {
-        Layer layer;
+        Layer& layer = layers[i];
         layer.id = i;
 
-        if (fscanf(inputFile, "%s %d %lf", name, &layer.direction, &layer.minLength) != 3) {
+        p = utils::skipSpaces(p, end);
+        p = utils::skipToken(p, end);  // layer name
+        int direction = 0;
+        if (!utils::parseInt(p, end, direction) || !utils::parseDouble(p, end, layer.minLength)) {
             std::cerr << "[ERROR] Failed to read layer information." << std::endl;
-            fclose(inputFile);
             return false;
         }
+        layer.direction = direction;
+        p = utils::skipLine(p, end);
 
-        layer.capacity.resize(dimension.y_size, std::vector<double>(dimension.x_size, 0.0));
+        layer.capacity.resize(static_cast<size_t>(dimension.y_size) * dimension.x_size);
         for (int y = 0; y < dimension.y_size; ++y) {
-            for (int x = 0; x < dimension.x_size; ++x) {
-                if (fscanf(inputFile, "%lf", &layer.capacity[y][x]) != 1) {
-                    std::cerr << "[ERROR] Failed to read layer capacity." << std::endl;
-                    fclose(inputFile);
-                    return false;
-                }
+            p = utils::skipSpaces(p, end);  // also skips blank lines
+            if (p == end) {
+                std::cerr << "[ERROR] Failed to read layer capacity." << std::endl;
+                return false;
             }
+            const char* lineEnd = utils::findLineEnd(p, end);
+            rows.push_back({p, lineEnd, layer.capacity.data() + static_cast<size_t>(y) * dimension.x_size});
+            p = lineEnd;
         }
-        layers.push_back(std::move(layer));
     }
 
-    fclose(inputFile);
+    const int numRows = rows.size();
+    const int xSize = dimension.x_size;
+    int numBadRows = 0;
+#pragma omp parallel for schedule(dynamic, 16) reduction(+ : numBadRows)
+    for (int r = 0; r < numRows; ++r) {
+        const CapacityRow& row = rows[r];
+        const char* q = row.begin;
+        for (int x = 0; x < xSize; ++x) {
+            if (!utils::parseDouble(q, row.end, row.values[x])) {
+                numBadRows++;
+                break;
+            }
+        }
+    }
+    if (numBadRows > 0) {
+        std::cerr << "[ERROR] Failed to read layer capacity." << std::endl;
+        return false;
+    }
 
     // print out the read information
     std::cout << "=====================================" << std::endl;
@@ -97,67 +127,154 @@ bool Design::readCap(const std::string& filename) {
     return true;
 }
 
+// Reads the "name slack" prefix of a pin line and returns the start of its access point list.
+// Lines without the prefix (i.e. starting with '[') are accepted as well.
+static const char* parsePinHeader(const char* p, const char* end, std::string_view& name, double& slack) {
+    auto isDelimiter = [](char c) { return utils::isSpace(c) || c == ','; };
+    auto skipDelimiters = [&](const char* q) {
+        while (q < end && isDelimiter(*q)) ++q;
+        return q;
+    };
+    name = std::string_view();
+    slack = 0.0;
+    p = skipDelimiters(p);
+    if (p < end && *p != '[') {
+        const char* nameEnd = p;
+        while (nameEnd < end && !isDelimiter(*nameEnd)) ++nameEnd;
+        name = std::string_view(p, nameEnd - p);
+        p = skipDelimiters(nameEnd);
+        if (p < end && *p != '[') {
+            const char* slackEnd = p;
+            utils::parseDouble(slackEnd, end, slack);
+            while (slackEnd < end && !isDelimiter(*slackEnd)) ++slackEnd;
+            p = slackEnd;
+        }
+    }
+    return p;
+}
+
+// Calls visit(layer, x, y) for every "(layer, x, y)" triple in [p, end) and returns their number
+template <typename Visit>
+static int forEachAccessPoint(const char* p, const char* end, Visit&& visit) {
+    int values[3];
+    int numValues = 0;
+    int numPoints = 0;
+    while (p < end) {
+        if (utils::isDigit(*p) || (*p == '-' && p + 1 < end && utils::isDigit(p[1]))) {
+            utils::parseInt(p, end, values[numValues++]);
+            if (numValues == 3) {
+                visit(values[0], values[1], values[2]);
+                numValues = 0;
+                numPoints++;
+            }
+        } else {
+            ++p;
+        }
+    }
+    return numPoints;
+}
+
 bool Design::readNet(const std::string& filename) {
-    FILE* inputFile = fopen(filename.c_str(), "r");
-    if (!inputFile) {
+    if (!netFile.open(filename)) {
         std::cerr << "[ERROR] Failed to open NET file: " << filename << std::endl;
         return false;
     }
+    const char* const begin = netFile.begin();
+    const char* const end = netFile.end();
 
-    std::vector<Net> nets;
-    std::vector<Pin> pins;
-    std::vector<Point> points;
-
-    char line[1000];
-    int net_id = 0, pin_id = 0, point_id = 0;
-
-    while (fgets(line, sizeof(line), inputFile)) {
-        if (line[strlen(line) - 1] == '\n') line[strlen(line) - 1] = '\0';
-
-        std::string netName(line);
-        Net net(net_id++, netName);
-        std::vector<int> pin_ids;
-
-        if (!fgets(line, sizeof(line), inputFile)) break; // Skip "(\n"
-        while (fgets(line, sizeof(line), inputFile)) {
-            std::string pinLine(line);
-            pinLine.erase(std::remove(pinLine.begin(), pinLine.end(), ' '), pinLine.end());
+    // 1. Pre-scan: locate the name and the "(" ... ")" body of every net
+    struct NetBlock {
+        std::string_view name;
+        const char* begin;
+        const char* end;
+    };
+    std::vector<NetBlock> blocks;
+    const char* p = begin;
+    while ((p = utils::skipSpaces(p, end)) < end) {
+        const char* lineEnd = utils::findLineEnd(p, end);
+        const char* nameEnd = lineEnd;
+        while (nameEnd > p && utils::isSpace(nameEnd[-1])) --nameEnd;
+        NetBlock block;
+        block.name = std::string_view(p, nameEnd - p);
 
-            if (pinLine == ")\n" || pinLine == ")") break;
-
-            Pin pin(pin_id++, net.id);
-            std::vector<int> point_ids;
-
-            char* token = strtok(line, ", \t\n");
-            pin.name = token ? token : "";
-
-            token = strtok(nullptr, ", \t\n");
-            pin.slack = token ? std::atof(token) : 0.0;
-
-            token = strtok(nullptr, ", \t\n");
-            replaceChars(token);
-
-            while (token) {
-                int layer = std::atoi(token);
-                token = strtok(nullptr, " \t\n");
-                if (!token) break;
-                int x = std::atoi(token);
-                token = strtok(nullptr, " \t\n");
-                if (!token) break;
-                int y = std::atoi(token);
-                token = strtok(nullptr, " \t\n");
-
-                points.emplace_back(point_id++, net.id, layer, x, y);
-                point_ids.push_back(point_id - 1);
+        p = utils::skipSpaces(lineEnd, end);
+        if (p == end || *p != '(') {
+            std::cerr << "[ERROR] Missing '(' after net " << block.name << " in NET file." << std::endl;
+            return false;
+        }
+        p = utils::skipLine(p, end);
+        block.begin = p;
+        while (true) {
+            if (p == end) {
+                std::cerr << "[ERROR] Missing ')' after net " << block.name << " in NET file." << std::endl;
+                return false;
+            }
+            lineEnd = utils::findLineEnd(p, end);
+            const char* q = p;
+            while (q < lineEnd && utils::isSpace(*q)) ++q;
+            if (q < lineEnd && *q == ')') {
+                block.end = p;
+                p = lineEnd;
+                break;
             }
+            p = lineEnd < end ? lineEnd + 1 : end;
+        }
+        blocks.push_back(block);
+    }
 
-            pin.point_ids = std::move(point_ids);
-            pins.push_back(std::move(pin));
-            pin_ids.push_back(pins.back().id);
+    // Visits the non-blank pin lines of a net body
+    auto forEachPinLine = [](const NetBlock& block, auto&& visit) {
+        const char* line = block.begin;
+        while (line < block.end) {
+            const char* lineEnd = utils::findLineEnd(line, block.end);
+            if (utils::skipSpaces(line, lineEnd) < lineEnd) visit(line, lineEnd);
+            line = lineEnd + 1;
         }
+    };
+
+    // 2. Count pins and access points per net, then turn the counts into offsets
+    const int numNets = blocks.size();
+    std::vector<int> pinOffsets(numNets + 1, 0);
+    std::vector<int> pointOffsets(numNets + 1, 0);
+#pragma omp parallel for schedule(dynamic, 256)
+    for (int i = 0; i < numNets; ++i) {
+        int numPins = 0, numPoints = 0;
+        forEachPinLine(blocks[i], [&](const char* line, const char* lineEnd) {
+            std::string_view name;
+            double slack;
+            const char* list = parsePinHeader(line, lineEnd, name, slack);
+            numPins++;
+            numPoints += forEachAccessPoint(list, lineEnd, [](int, int, int) {});
+        });
+        pinOffsets[i + 1] = numPins;
+        pointOffsets[i + 1] = numPoints;
+    }
+    for (int i = 0; i < numNets; ++i) {
+        pinOffsets[i + 1] += pinOffsets[i];
+        pointOffsets[i + 1] += pointOffsets[i];
+    }
 
-        net.pin_ids = std::move(pin_ids);
-        nets.push_back(std::move(net));
+    // 3. Parse every net straight into its slots of the preallocated arrays
+    std::vector<Net> nets(numNets);
+    std::vector<Pin> pins(pinOffsets[numNets]);
+    std::vector<Point> points(pointOffsets[numNets]);
+#pragma omp parallel for schedule(dynamic, 256)
+    for (int i = 0; i < numNets; ++i) {
+        Net& net = nets[i];
+        net = Net(i, blocks[i].name);
+        net.pin_ids.reserve(pinOffsets[i + 1] - pinOffsets[i]);
+        int pin_id = pinOffsets[i];
+        int point_id = pointOffsets[i];
+        forEachPinLine(blocks[i], [&](const char* line, const char* lineEnd) {
+            Pin& pin = pins[pin_id];
+            pin = Pin(pin_id, net.id);
+            const char* list = parsePinHeader(line, lineEnd, pin.name, pin.slack);
+            forEachAccessPoint(list, lineEnd, [&](int layer, int x, int y) {
+                points[point_id] = Point(point_id, net.id, layer, x, y);
+                pin.point_ids.push_back(point_id++);
+            });
+            net.pin_ids.push_back(pin_id++);
+        });
     }
 
     netlist.n_nets = nets.size();
@@ -173,15 +290,5 @@ bool Design::readNet(const std::string& filename) {
     std::cout << "[INFO] Number of points: " << netlist.n_points << std::endl;
     std::cout << "=====================================" << std::endl;
 
-    fclose(inputFile);
     return true;
 }
-
-void Design::replaceChars(char* str) {
-    while (str && *str) {
-        if (*str == '[' || *str == ']' || *str == '(' || *str == ')') {
-            *str = ' ';
-        }
-        ++str;
-    }
-}
\ No newline at end of file
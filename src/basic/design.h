@@ -11,12 +11,26 @@
 #include "layer.h"
 #include "metrics.h"
 #include "netlist.h"
+#include "../utils/mmap.h"
 
 class Design {
 public:
     explicit Design(Parameters& params)
         : parameters(params) {
         auto start = std::chrono::high_resolution_clock::now();
+        if (!params.load_snapshot_file.empty()) {
+            if (loadSnapshot(params.load_snapshot_file)) {
+                std::cout << "[INFO] Time taken to load snapshot: "
+                          << std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count()
+                          << " seconds." << std::endl;
+                dumpSnapshotIfRequested();
+                return;
+            }
+            std::cerr << "[ERROR] Falling back to the CAP and NET files." << std::endl;
+            snapshotFile.close();
+            start = std::chrono::high_resolution_clock::now();
+        }
+
         if (readCap(params.cap_file)) {
             std::cout << "[INFO] Time taken to read CAP: "
                       << std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count()
@@ -29,6 +43,7 @@ public:
                       << std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count()
                       << " seconds." << std::endl;
         }
+        dumpSnapshotIfRequested();
     }
 
     ~Design() = default;
@@ -36,8 +51,8 @@ public:
     // Member functions
     bool readCap(const std::string& filename);
     bool readNet(const std::string& filename);
-
-    void replaceChars(char* str);
+    bool dumpSnapshot(const std::string& filename) const;  // see snapshot.h for the format
+    bool loadSnapshot(const std::string& filename);
 
     // Member variables
     Parameters& parameters;
@@ -45,6 +60,20 @@ public:
     std::vector<Layer> layers;
     Dimension dimension;
     Metrics metrics;
+
+private:
+    void dumpSnapshotIfRequested() const {
+        if (parameters.dump_snapshot_file.empty()) return;
+        auto start = std::chrono::high_resolution_clock::now();
+        if (dumpSnapshot(parameters.dump_snapshot_file)) {
+            std::cout << "[INFO] Time taken to dump snapshot: "
+                      << std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count()
+                      << " seconds." << std::endl;
+        }
+    }
+
+    utils::MappedFile netFile;       // keeps the net and pin names of netlist valid
+    utils::MappedFile snapshotFile;  // same, when the design is loaded from a snapshot
 };
 
 #endif  // DESIGN_H
@@ -11,7 +11,7 @@ public:
     int id; 
     bool direction; // 0: horizontal, 1: vertical
     double minLength;
-    vector<vector<double>> capacity;  
+    vector<double> capacity;  // capacity[y * x_size + x]
 };
 
 #endif // LAYER_H
@@ -4,6 +4,7 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 
 using namespace std;
 
@@ -24,27 +25,30 @@ public:
 
 class Net {
 public:
-    Net(int id, const string& name) : id(id), name(name) {}
+    Net() = default;
+    Net(int id, string_view name) : id(id), name(name) {}
 
     int id;
-    string name;
+    string_view name;  // points into the memory-mapped NET file owned by Design
     vector<int> pin_ids;
     
 };
 
 class Pin {
 public:
+    Pin() = default;
     Pin(int id, int net_id) : id(id), net_id(net_id) {}
 
     int id;
     int net_id;
     double slack;
-    string name;
+    string_view name;
     vector<int> point_ids;
 };
 
 class Point {
 public:
+    Point() = default;
     Point(int id, int net_id, int layer, int x, int y) : id(id), net_id(net_id), layer(layer), x(x), y(y) {}
     
     int id;
@@ -0,0 +1,288 @@
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../basic/design.h"
+#include "../basic/snapshot.h"
+
+static uint64_t alignSnapshotOffset(uint64_t offset) {
+    return (offset + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+}
+
+bool Design::dumpSnapshot(const std::string& filename) const {
+    const size_t gridSize = static_cast<size_t>(dimension.x_size) * dimension.y_size;
+
+    // Flatten the netlist; pins and points are renumbered in net order
+    std::vector<int32_t> directions(dimension.n_layers);
+    std::vector<double> minLengths(dimension.n_layers);
+    for (int i = 0; i < dimension.n_layers; ++i) {
+        directions[i] = layers[i].direction;
+        minLengths[i] = layers[i].minLength;
+    }
+    std::vector<int32_t> netPins(1, 0);
+    std::vector<uint64_t> netNames(1, 0);
+    std::vector<int32_t> pinPoints(1, 0);
+    std::vector<uint64_t> pinNames;
+    std::vector<double> pinSlacks;
+    std::vector<int32_t> points;
+    std::string names;
+    netPins.reserve(netlist.nets.size() + 1);
+    netNames.reserve(netlist.nets.size() + 1);
+    pinPoints.reserve(netlist.pins.size() + 1);
+    pinSlacks.reserve(netlist.pins.size());
+    points.reserve(netlist.points.size() * 3);
+    for (const Net& net : netlist.nets) {
+        names.append(net.name);
+        netNames.push_back(names.size());
+        for (int pin_id : net.pin_ids) {
+            const Pin& pin = netlist.pins[pin_id];
+            for (int point_id : pin.point_ids) {
+                const Point& point = netlist.points[point_id];
+                points.push_back(point.layer);
+                points.push_back(point.x);
+                points.push_back(point.y);
+            }
+            pinPoints.push_back(points.size() / 3);
+            pinSlacks.push_back(pin.slack);
+        }
+        netPins.push_back(pinSlacks.size());
+    }
+    pinNames.reserve(pinSlacks.size() + 1);
+    pinNames.push_back(names.size());
+    for (const Net& net : netlist.nets) {
+        for (int pin_id : net.pin_ids) {
+            names.append(netlist.pins[pin_id].name);
+            pinNames.push_back(names.size());
+        }
+    }
+
+    struct Chunk {
+        const void* data;
+        size_t size;
+    };
+    std::vector<std::vector<Chunk>> sections(SNAPSHOT_NUM_SECTIONS);
+    sections[SNAPSHOT_OF_WEIGHTS] = {{metrics.OFWeight.data(), metrics.OFWeight.size() * sizeof(double)}};
+    sections[SNAPSHOT_LAYER_DIRECTIONS] = {{directions.data(), directions.size() * sizeof(int32_t)}};
+    sections[SNAPSHOT_LAYER_MIN_LENGTHS] = {{minLengths.data(), minLengths.size() * sizeof(double)}};
+    sections[SNAPSHOT_H_EDGES] = {{dimension.hEdge.data(), dimension.hEdge.size() * sizeof(int32_t)}};
+    sections[SNAPSHOT_V_EDGES] = {{dimension.vEdge.data(), dimension.vEdge.size() * sizeof(int32_t)}};
+    for (const Layer& layer : layers) {
+        sections[SNAPSHOT_CAPACITIES].push_back({layer.capacity.data(), gridSize * sizeof(double)});
+    }
+    sections[SNAPSHOT_NET_PINS] = {{netPins.data(), netPins.size() * sizeof(int32_t)}};
+    sections[SNAPSHOT_NET_NAMES] = {{netNames.data(), netNames.size() * sizeof(uint64_t)}};
+    sections[SNAPSHOT_PIN_POINTS] = {{pinPoints.data(), pinPoints.size() * sizeof(int32_t)}};
+    sections[SNAPSHOT_PIN_NAMES] = {{pinNames.data(), pinNames.size() * sizeof(uint64_t)}};
+    sections[SNAPSHOT_PIN_SLACKS] = {{pinSlacks.data(), pinSlacks.size() * sizeof(double)}};
+    sections[SNAPSHOT_POINTS] = {{points.data(), points.size() * sizeof(int32_t)}};
+    sections[SNAPSHOT_NAMES] = {{names.data(), names.size()}};
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.headerSize = sizeof(SnapshotHeader);
+    header.nLayers = dimension.n_layers;
+    header.xSize = dimension.x_size;
+    header.ySize = dimension.y_size;
+    header.unitLengthWireCost = metrics.UnitLengthWireCost;
+    header.unitViaCost = metrics.UnitViaCost;
+    header.numNets = netlist.nets.size();
+    header.numPins = pinSlacks.size();
+    header.numPoints = points.size() / 3;
+    header.numNameBytes = names.size();
+    uint64_t offset = alignSnapshotOffset(sizeof(SnapshotHeader));
+    for (int s = 0; s < SNAPSHOT_NUM_SECTIONS; ++s) {
+        header.sectionOffsets[s] = offset;
+        for (const Chunk& chunk : sections[s]) header.sectionSizes[s] += chunk.size;
+        offset = alignSnapshotOffset(offset + header.sectionSizes[s]);
+    }
+    header.fileSize = offset;
+
+    FILE* out = fopen(filename.c_str(), "wb");
+    if (!out) {
+        std::cerr << "[ERROR] Failed to open snapshot file: " << filename << std::endl;
+        return false;
+    }
+    static const char padding[SNAPSHOT_ALIGNMENT] = {0};
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+    uint64_t written = sizeof(header);
+    for (int s = 0; s < SNAPSHOT_NUM_SECTIONS && ok; ++s) {
+        ok &= fwrite(padding, 1, header.sectionOffsets[s] - written, out) == header.sectionOffsets[s] - written;
+        for (const Chunk& chunk : sections[s]) {
+            if (chunk.size > 0) ok &= fwrite(chunk.data, 1, chunk.size, out) == chunk.size;
+        }
+        written = header.sectionOffsets[s] + header.sectionSizes[s];
+    }
+    ok &= fwrite(padding, 1, header.fileSize - written, out) == header.fileSize - written;
+    ok &= fclose(out) == 0;
+    if (!ok) {
+        std::cerr << "[ERROR] Failed to write snapshot file: " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Design::loadSnapshot(const std::string& filename) {
+    if (!snapshotFile.open(filename)) {
+        std::cerr << "[ERROR] Failed to open snapshot file: " << filename << std::endl;
+        return false;
+    }
+    if (snapshotFile.size() < sizeof(SnapshotHeader)) {
+        std::cerr << "[ERROR] Snapshot file is truncated: " << filename << std::endl;
+        return false;
+    }
+    const SnapshotHeader& header = *reinterpret_cast<const SnapshotHeader*>(snapshotFile.data());
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+        std::cerr << "[ERROR] Not a design snapshot: " << filename << std::endl;
+        return false;
+    }
+    if (header.version != SNAPSHOT_VERSION || header.headerSize != sizeof(SnapshotHeader)) {
+        std::cerr << "[ERROR] Unsupported snapshot version " << header.version << " (expected " << SNAPSHOT_VERSION
+                  << "): " << filename << std::endl;
+        return false;
+    }
+
+    // Validate the section table against the counts in the header
+    const uint64_t gridSize = static_cast<uint64_t>(header.xSize) * header.ySize;
+    const uint64_t expectedSizes[SNAPSHOT_NUM_SECTIONS] = {
+        header.nLayers * sizeof(double),
+        header.nLayers * sizeof(int32_t),
+        header.nLayers * sizeof(double),
+        (header.xSize - 1) * sizeof(int32_t),
+        (header.ySize - 1) * sizeof(int32_t),
+        header.nLayers * gridSize * sizeof(double),
+        (header.numNets + 1) * sizeof(int32_t),
+        (header.numNets + 1) * sizeof(uint64_t),
+        (header.numPins + 1) * sizeof(int32_t),
+        (header.numPins + 1) * sizeof(uint64_t),
+        header.numPins * sizeof(double),
+        header.numPoints * 3 * sizeof(int32_t),
+        header.numNameBytes,
+    };
+    // Every count must fit into the int ids of the netlist, and every element takes at least one byte, so counts that
+    // pass this check cannot overflow the section sizes computed from them
+    const uint64_t maxCount = std::min<uint64_t>(snapshotFile.size(), INT32_MAX - 1);
+    bool valid = header.fileSize == snapshotFile.size() && header.nLayers > 0 && header.xSize > 0 && header.ySize > 0 &&
+                 static_cast<uint64_t>(header.nLayers) <= maxCount && static_cast<uint64_t>(header.xSize) <= maxCount &&
+                 static_cast<uint64_t>(header.ySize) <= maxCount && gridSize <= maxCount / header.nLayers &&
+                 header.numNets <= maxCount && header.numPins <= maxCount && header.numPoints <= maxCount / 3 &&
+                 header.numNameBytes <= maxCount;
+    for (int s = 0; s < SNAPSHOT_NUM_SECTIONS && valid; ++s) {
+        valid = header.sectionSizes[s] == expectedSizes[s] && header.sectionOffsets[s] % SNAPSHOT_ALIGNMENT == 0 &&
+                header.sectionOffsets[s] <= header.fileSize && header.sectionSizes[s] <= header.fileSize - header.sectionOffsets[s];
+    }
+    if (!valid) {
+        std::cerr << "[ERROR] Snapshot file is corrupted: " << filename << std::endl;
+        return false;
+    }
+    auto section = [&](SnapshotSection s) { return snapshotFile.data() + header.sectionOffsets[s]; };
+
+    const int32_t* hEdges = reinterpret_cast<const int32_t*>(section(SNAPSHOT_H_EDGES));
+    const int32_t* vEdges = reinterpret_cast<const int32_t*>(section(SNAPSHOT_V_EDGES));
+    const double* weights = reinterpret_cast<const double*>(section(SNAPSHOT_OF_WEIGHTS));
+    const int32_t* directions = reinterpret_cast<const int32_t*>(section(SNAPSHOT_LAYER_DIRECTIONS));
+    const double* minLengths = reinterpret_cast<const double*>(section(SNAPSHOT_LAYER_MIN_LENGTHS));
+    const double* capacities = reinterpret_cast<const double*>(section(SNAPSHOT_CAPACITIES));
+    const int32_t* netPins = reinterpret_cast<const int32_t*>(section(SNAPSHOT_NET_PINS));
+    const uint64_t* netNames = reinterpret_cast<const uint64_t*>(section(SNAPSHOT_NET_NAMES));
+    const int32_t* pinPoints = reinterpret_cast<const int32_t*>(section(SNAPSHOT_PIN_POINTS));
+    const uint64_t* pinNames = reinterpret_cast<const uint64_t*>(section(SNAPSHOT_PIN_NAMES));
+    const double* pinSlacks = reinterpret_cast<const double*>(section(SNAPSHOT_PIN_SLACKS));
+    const int32_t* points = reinterpret_cast<const int32_t*>(section(SNAPSHOT_POINTS));
+    const char* names = section(SNAPSHOT_NAMES);
+
+    // Validate the contents before any state is built from them: layer directions, every offset table (non-decreasing
+    // from 0 up to the size of the table it points into) and the location of every access point
+    for (int i = 0; i < header.nLayers && valid; ++i) {
+        valid = directions[i] == 0 || directions[i] == 1;
+    }
+    auto checkOffsets = [](const auto* offsets, uint64_t count, uint64_t first, uint64_t last) {
+        if (static_cast<uint64_t>(offsets[0]) != first || static_cast<uint64_t>(offsets[count]) != last)
+            return false;
+        for (uint64_t i = 0; i < count; ++i) {
+            if (offsets[i + 1] < offsets[i])
+                return false;
+        }
+        return true;
+    };
+    valid = valid && checkOffsets(netPins, header.numNets, 0, header.numPins) &&
+            checkOffsets(pinPoints, header.numPins, 0, header.numPoints) &&
+            checkOffsets(netNames, header.numNets, 0, pinNames[0]) &&
+            checkOffsets(pinNames, header.numPins, netNames[header.numNets], header.numNameBytes);
+    if (valid) {
+        const int64_t numPoints = header.numPoints;
+        int64_t numInvalid = 0;
+#pragma omp parallel for schedule(static) reduction(+ : numInvalid)
+        for (int64_t i = 0; i < numPoints; ++i) {
+            const int32_t* point = points + 3 * i;
+            numInvalid += point[0] < 0 || point[0] >= header.nLayers || point[1] < 0 || point[1] >= header.xSize ||
+                          point[2] < 0 || point[2] >= header.ySize;
+        }
+        valid = numInvalid == 0;
+    }
+    if (!valid) {
+        std::cerr << "[ERROR] Snapshot file is corrupted: " << filename << std::endl;
+        return false;
+    }
+
+    dimension.n_layers = header.nLayers;
+    dimension.x_size = header.xSize;
+    dimension.y_size = header.ySize;
+    dimension.hEdge.assign(hEdges, hEdges + header.xSize - 1);
+    dimension.vEdge.assign(vEdges, vEdges + header.ySize - 1);
+
+    metrics.UnitLengthWireCost = header.unitLengthWireCost;
+    metrics.UnitViaCost = header.unitViaCost;
+    parameters.UnitViaCost = metrics.UnitViaCost;
+    metrics.OFWeight.assign(weights, weights + header.nLayers);
+
+    layers.resize(header.nLayers);
+    for (int i = 0; i < header.nLayers; ++i) {
+        layers[i].id = i;
+        layers[i].direction = directions[i];
+        layers[i].minLength = minLengths[i];
+        layers[i].capacity.assign(capacities + i * gridSize, capacities + (i + 1) * gridSize);
+    }
+
+    const int numNets = header.numNets;
+    netlist.nets.resize(numNets);
+    netlist.pins.resize(header.numPins);
+    netlist.points.resize(header.numPoints);
+#pragma omp parallel for schedule(dynamic, 256)
+    for (int i = 0; i < numNets; ++i) {
+        Net& net = netlist.nets[i];
+        net = Net(i, std::string_view(names + netNames[i], netNames[i + 1] - netNames[i]));
+        net.pin_ids.reserve(netPins[i + 1] - netPins[i]);
+        for (int pin_id = netPins[i]; pin_id < netPins[i + 1]; ++pin_id) {
+            Pin& pin = netlist.pins[pin_id];
+            pin = Pin(pin_id, i);
+            pin.slack = pinSlacks[pin_id];
+            pin.name = std::string_view(names + pinNames[pin_id], pinNames[pin_id + 1] - pinNames[pin_id]);
+            pin.point_ids.reserve(pinPoints[pin_id + 1] - pinPoints[pin_id]);
+            for (int point_id = pinPoints[pin_id]; point_id < pinPoints[pin_id + 1]; ++point_id) {
+                const int32_t* point = points + 3 * static_cast<size_t>(point_id);
+                netlist.points[point_id] = Point(point_id, i, point[0], point[1], point[2]);
+                pin.point_ids.push_back(point_id);
+            }
+            net.pin_ids.push_back(pin_id);
+        }
+    }
+    netlist.n_nets = netlist.nets.size();
+    netlist.n_pins = netlist.pins.size();
+    netlist.n_points = netlist.points.size();
+
+    std::cout << "=====================================" << std::endl;
+    std::cout << "[INFO] Number of layers: " << dimension.n_layers << std::endl;
+    std::cout << "[INFO] Grid dimension: " << dimension.x_size << " x " << dimension.y_size << std::endl;
+    std::cout << "[INFO] Number of nets: " << netlist.n_nets << std::endl;
+    std::cout << "[INFO] Number of pins: " << netlist.n_pins << std::endl;
+    std::cout << "[INFO] Number of points: " << netlist.n_points << std::endl;
+    std::cout << "=====================================" << std::endl;
+
+    return true;
+}
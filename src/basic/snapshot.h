@@ -0,0 +1,57 @@
+// snapshot.h
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+
+// Binary snapshot of a parsed design (--dump-snapshot / --load-snapshot).
+//
+// The file starts with a SnapshotHeader followed by the sections listed in SnapshotSection.
+// Every section starts at a 64-byte aligned offset recorded in the header, so a loader can
+// use the arrays in place from a single read-only mapping of the file. Bump
+// SNAPSHOT_VERSION whenever the layout changes; older snapshots are then rejected.
+
+#define SNAPSHOT_MAGIC "NTUGRSNP"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_ALIGNMENT 64
+
+enum SnapshotSection {
+    SNAPSHOT_OF_WEIGHTS,         // double[nLayers]
+    SNAPSHOT_LAYER_DIRECTIONS,   // int32_t[nLayers]
+    SNAPSHOT_LAYER_MIN_LENGTHS,  // double[nLayers]
+    SNAPSHOT_H_EDGES,            // int32_t[xSize - 1]
+    SNAPSHOT_V_EDGES,            // int32_t[ySize - 1]
+    SNAPSHOT_CAPACITIES,         // double[nLayers][ySize][xSize]
+    SNAPSHOT_NET_PINS,           // int32_t[numNets + 1], pin offsets of every net
+    SNAPSHOT_NET_NAMES,          // uint64_t[numNets + 1], offsets into SNAPSHOT_NAMES
+    SNAPSHOT_PIN_POINTS,         // int32_t[numPins + 1], access point offsets of every pin
+    SNAPSHOT_PIN_NAMES,          // uint64_t[numPins + 1], offsets into SNAPSHOT_NAMES
+    SNAPSHOT_PIN_SLACKS,         // double[numPins]
+    SNAPSHOT_POINTS,             // int32_t[numPoints][3], (layer, x, y)
+    SNAPSHOT_NAMES,              // char[numNameBytes], net names followed by pin names
+    SNAPSHOT_NUM_SECTIONS
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t fileSize;
+
+    int32_t nLayers;
+    int32_t xSize;
+    int32_t ySize;
+    int32_t reserved;
+    double unitLengthWireCost;
+    double unitViaCost;
+
+    uint64_t numNets;
+    uint64_t numPins;
+    uint64_t numPoints;
+    uint64_t numNameBytes;
+
+    uint64_t sectionOffsets[SNAPSHOT_NUM_SECTIONS];
+    uint64_t sectionSizes[SNAPSHOT_NUM_SECTIONS];  // in bytes
+};
+
+#endif  // SNAPSHOT_H
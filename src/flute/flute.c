@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <limits.h>
 #include <math.h>
+#include <string.h>
 #include "flute.h"
 
 #if D<=7
@@ -32,13 +33,28 @@ struct point
     int o;
 };
 
+// Scratch space of flute(), one per thread so that concurrent calls neither share
+// state nor allocate. LUT and numsoln are read-only after readLUT().
+struct flute_workspace
+{
+    int capacity;  // max. degree the buffers can hold
+    DTYPE *xs, *ys;
+    int *s;
+    struct point *pt, **ptp;
+    Branch *branch;  // branches of the tree returned by the last flute() call
+};
+static _Thread_local struct flute_workspace ws;
+
 void readLUT();
+void readLUTFiles(const char *powvfile, const char *postfile);
+int writeLUTBlob(const char *file);
 DTYPE flute_wl(int d, DTYPE x[], DTYPE y[], int acc);
 DTYPE flutes_wl_LD(int d, DTYPE xs[], DTYPE ys[], int s[]);
 DTYPE flutes_wl_MD(int d, DTYPE xs[], DTYPE ys[], int s[], int acc);
 DTYPE flutes_wl_RDP(int d, DTYPE xs[], DTYPE ys[], int s[], int acc);
 Tree flute(int d, DTYPE x[], DTYPE y[], int acc);
 Tree flutes_LD(int d, DTYPE xs[], DTYPE ys[], int s[]);
+static Tree flutes_LD_into(int d, DTYPE xs[], DTYPE ys[], int s[], Branch *branch);
 Tree flutes_MD(int d, DTYPE xs[], DTYPE ys[], int s[], int acc);
 Tree flutes_RDP(int d, DTYPE xs[], DTYPE ys[], int s[], int acc);
 Tree dmergetree(Tree t1, Tree t2);
@@ -49,14 +65,75 @@ DTYPE wirelength(Tree t);
 void printtree(Tree t);
 void plottree(Tree t);
 
-void readLUT()
+// Binary form of LUT/numsoln: a header, then (numsoln, index of the first solution)
+// for every group of d = 4..D, then all distinct solutions. Groups sharing solutions
+// share the index. lutgen.c writes it at build time and lut_blob.c embeds it, so
+// readLUT() only fills the group tables and uses the solutions in place.
+#define LUT_MAGIC "FLUTELUT"
+struct lut_header
+{
+    char magic[8];
+    int d;            // D
+    int csoln_size;   // sizeof(struct csoln)
+    int numgroups;    // sum of numgrp[4..D]
+    int numsolns;
+    int topologies;   // rowcol/neighbor hold the POST topologies; 0 if the LUT was built without POST9.dat
+};
+struct lut_group
+{
+    int numsoln;
+    int first;
+};
+
+const unsigned char *lut_blob(size_t *size);  // lut_blob.c, NULL if no table was embedded
+
+static unsigned char *parsed_lut;  // binary LUT built from the text tables
+static size_t parsed_lut_size;
+static int lut_topologies;  // without them, flutes_LD() connects 4 .. D pins by a minimum spanning tree
+
+static int lut_numgroups()
+{
+    int d, n = 0;
+
+    for (d=4; d<=D; d++) n += numgrp[d];
+    return n;
+}
+
+// Point LUT/numsoln into a binary LUT; returns 0 if it was built with other parameters
+static int loadLUTBlob(const unsigned char *blob, size_t size)
+{
+    const struct lut_header *header = (const struct lut_header *) blob;
+    const struct lut_group *group;
+    const struct csoln *solns;
+    int d, k, numgroups = lut_numgroups();
+
+    if (size < sizeof(struct lut_header) || memcmp(header->magic, LUT_MAGIC, 8) != 0 ||
+        header->d != D || header->csoln_size != sizeof(struct csoln) || header->numgroups != numgroups ||
+        size != sizeof(struct lut_header) + numgroups*sizeof(struct lut_group) + header->numsolns*sizeof(struct csoln))
+        return 0;
+
+    group = (const struct lut_group *) (header + 1);
+    solns = (const struct csoln *) (group + numgroups);
+    for (d=4; d<=D; d++) {
+        for (k=0; k<numgrp[d]; k++, group++) {
+            numsoln[d][k] = group->numsoln;
+            LUT[d][k] = (struct csoln *) (solns + group->first);
+        }
+    }
+    lut_topologies = header->topologies;
+    return 1;
+}
+
+// Parse the text tables into parsed_lut. The POST table is optional (NULL, missing or empty):
+// without it the LUT only estimates wirelengths.
+static void parseLUT(const char *powvfile, const char *postfile)
 {
     unsigned char charnum[256], line[32], *linep, c;
     FILE *fpwv, *fprt;
-    struct csoln *p;
-    int d, i, j, k, kk, ns, nn;
-
-    init_param();
+    struct lut_header header;
+    struct lut_group *groups, *dgroups;
+    struct csoln *solns, *p;
+    int d, i, j, k, kk, ns, nn, maxsolns;
 
     for (i=0; i<=255; i++) {
         if ('0'<=i && i<='9')
@@ -67,39 +144,60 @@ void readLUT()
             charnum[i] = 0;
     }
 
-    fpwv=fopen(POWVFILE, "r");
+    fpwv=fopen(powvfile, "r");
     if (fpwv == NULL) {
-        printf("Error in opening %s\n", POWVFILE);
+        printf("Error in opening %s\n", powvfile);
         exit(1);
     }
 
+    fprt = NULL;
 #if ROUTING==1
-    fprt=fopen(POSTFILE, "r");
-    if (fprt == NULL) {
-        printf("Error in opening %s\n", POSTFILE);
-        exit(1);
+    if (postfile != NULL)
+        fprt = fopen(postfile, "r");
+    if (fprt != NULL && fgetc(fprt) == EOF) {
+        fclose(fprt);
+        fprt = NULL;
     }
+    if (fprt == NULL)
+        printf("Warning: no Steiner topologies in %s, trees of degree 4..%d are spanning trees\n",
+               postfile != NULL ? postfile : "(none)", D);
+    else
+        rewind(fprt);
 #endif
 
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LUT_MAGIC, 8);
+    header.d = D;
+    header.csoln_size = sizeof(struct csoln);
+    header.numgroups = lut_numgroups();
+    header.topologies = fprt != NULL;
+    groups = (struct lut_group *) malloc(header.numgroups*sizeof(struct lut_group));
+    maxsolns = header.numgroups;
+    solns = (struct csoln *) malloc(maxsolns*sizeof(struct csoln));
+
     int status_code; // useles, just to stop compile warning
+    dgroups = groups;
     for (d=4; d<=D; d++) {
         status_code = fscanf(fpwv, "d=%d\n", &d);
-#if ROUTING==1
-        status_code = fscanf(fprt, "d=%d\n", &d);
-#endif
+        if (fprt != NULL)
+            status_code = fscanf(fprt, "d=%d\n", &d);
         for (k=0; k<numgrp[d]; k++) {
             ns = (int) charnum[fgetc(fpwv)];
 
             if (ns==0) {  // same as some previous group
                 status_code = fscanf(fpwv, "%d\n", &kk);
-                numsoln[d][k] = numsoln[d][kk];
-                LUT[d][k] = LUT[d][kk];
+                dgroups[k] = dgroups[kk];
             }
             else {
                 fgetc(fpwv);  // '\n'
-                numsoln[d][k] = ns;
-                p = (struct csoln*) malloc(ns*sizeof(struct csoln));
-                LUT[d][k] = p;
+                dgroups[k].numsoln = ns;
+                dgroups[k].first = header.numsolns;
+                if (header.numsolns + ns > maxsolns) {
+                    maxsolns = 2*maxsolns + ns;
+                    solns = (struct csoln *) realloc(solns, maxsolns*sizeof(struct csoln));
+                }
+                p = solns + header.numsolns;
+                header.numsolns += ns;
                 for (i=1; i<=ns; i++) {
                     linep = (unsigned char *) fgets((char *) line, 32, fpwv);
                     p->parent = charnum[*(linep++)];
@@ -107,25 +205,110 @@ void readLUT()
                     while ((p->seg[j++] = charnum[*(linep++)]) != 0) ;
                     j = 10;
                     while ((p->seg[j--] = charnum[*(linep++)]) != 0) ;
-#if ROUTING==1
-                    nn = 2*d-2;
-                    status_code = fread(line, 1, d-2, fprt); linep=line;
-                    for (j=d; j<nn; j++) {
-                        c = charnum[*(linep++)];
-                        p->rowcol[j-d] = c;
+                    memset(p->rowcol, 0, sizeof(p->rowcol));
+                    memset(p->neighbor, 0, sizeof(p->neighbor));
+                    if (fprt != NULL) {
+                        nn = 2*d-2;
+                        status_code = fread(line, 1, d-2, fprt); linep=line;
+                        for (j=d; j<nn; j++) {
+                            c = charnum[*(linep++)];
+                            p->rowcol[j-d] = c;
+                        }
+                        status_code = fread(line, 1, nn/2+1, fprt); linep=line;  // last char \n
+                        for (j=0; j<nn; ) {
+                            c = *(linep++);
+                            p->neighbor[j++] = c/16;
+                            p->neighbor[j++] = c%16;
+                        }
                     }
-                    status_code = fread(line, 1, nn/2+1, fprt); linep=line;  // last char \n
-                    for (j=0; j<nn; ) {
-                        c = *(linep++);
-                        p->neighbor[j++] = c/16;
-                        p->neighbor[j++] = c%16;
-                    }
-#endif
                     p++;
                 }
             }
         }
+        dgroups += numgrp[d];
     }
+    fclose(fpwv);
+    if (fprt != NULL)
+        fclose(fprt);
+
+    free(parsed_lut);
+    parsed_lut_size = sizeof(header) + header.numgroups*sizeof(struct lut_group) + header.numsolns*sizeof(struct csoln);
+    parsed_lut = (unsigned char *) malloc(parsed_lut_size);
+    memcpy(parsed_lut, &header, sizeof(header));
+    memcpy(parsed_lut + sizeof(header), groups, header.numgroups*sizeof(struct lut_group));
+    memcpy(parsed_lut + sizeof(header) + header.numgroups*sizeof(struct lut_group), solns, header.numsolns*sizeof(struct csoln));
+    free(groups);
+    free(solns);
+}
+
+// Read the text tables, e.g. custom ones
+void readLUTFiles(const char *powvfile, const char *postfile)
+{
+    init_param();
+    parseLUT(powvfile, postfile);
+    loadLUTBlob(parsed_lut, parsed_lut_size);
+}
+
+static int nonEmptyFile(const char *file)
+{
+    FILE *fp = fopen(file, "r");
+    int nonEmpty = fp != NULL && fgetc(fp) != EOF;
+
+    if (fp != NULL)
+        fclose(fp);
+    return nonEmpty;
+}
+
+// Use the tables embedded at build time, or read the text tables from FLUTE_LUT_DIR. A LUT embedded without
+// POST9.dat has no Steiner topologies, so text tables with them are read instead, from FLUTE_LUT_DIR or else
+// from the working directory.
+void readLUT()
+{
+    static const char *const tables[][2] = {{POWVFILE, POSTFILE}, {"POWV9.dat", "POST9.dat"}};
+    size_t size;
+    const unsigned char *blob = lut_blob(&size);
+    int i;
+
+    if (blob != NULL) {
+        init_param();
+        if (loadLUTBlob(blob, size)) {
+            if (lut_topologies)
+                return;
+            for (i=0; i<2; i++) {
+                if (nonEmptyFile(tables[i][0]) && nonEmptyFile(tables[i][1])) {
+                    readLUTFiles(tables[i][0], tables[i][1]);
+                    if (lut_topologies)
+                        return;
+                }
+            }
+            printf("Warning: the embedded FLUTE LUT has no Steiner topologies and no POST9.dat was found in %s or the working directory, trees of degree 4..%d are spanning trees\n",
+                   FLUTE_LUT_DIR, D);
+            return;
+        }
+        printf("Warning: the embedded FLUTE LUT does not match D=%d, reading %s\n", D, POWVFILE);
+    }
+    readLUTFiles(POWVFILE, POSTFILE);
+}
+
+// Write the tables last read by readLUTFiles() in binary form
+int writeLUTBlob(const char *file)
+{
+    FILE *fp;
+
+    if (parsed_lut == NULL)
+        return 0;
+    fp = fopen(file, "wb");
+    if (fp == NULL) {
+        printf("Error in opening %s\n", file);
+        return 0;
+    }
+    if (fwrite(parsed_lut, 1, parsed_lut_size, fp) != parsed_lut_size) {
+        printf("Error in writing %s\n", file);
+        fclose(fp);
+        return 0;
+    }
+    fclose(fp);
+    return 1;
 }
 
 DTYPE flute_wl(int d, DTYPE x[], DTYPE y[], int acc)
@@ -566,6 +749,21 @@ static int ordery(const void *a, const void *b)
     return 0;
 }
 
+static void reserve_workspace(int d)
+{
+    if (d <= ws.capacity)
+        return;
+    ws.capacity = flute_max(d, MAXD);
+    ws.xs = (DTYPE *)realloc(ws.xs, sizeof(DTYPE)*ws.capacity);
+    ws.ys = (DTYPE *)realloc(ws.ys, sizeof(DTYPE)*ws.capacity);
+    ws.s = (int *)realloc(ws.s, sizeof(int)*ws.capacity);
+    ws.pt = (struct point *)realloc(ws.pt, sizeof(struct point)*(ws.capacity+1));
+    ws.ptp = (struct point **)realloc(ws.ptp, sizeof(struct point*)*(ws.capacity+1));
+    ws.branch = (Branch *)realloc(ws.branch, sizeof(Branch)*(2*ws.capacity-2));
+}
+
+// Reentrant: the returned branches live in the workspace of the calling thread and
+// stay valid until its next call to flute(), so the caller must not free them.
 Tree flute(int d, DTYPE x[], DTYPE y[], int acc)
 {
     DTYPE *xs, *ys, minval;
@@ -574,10 +772,11 @@ Tree flute(int d, DTYPE x[], DTYPE y[], int acc)
     struct point *pt, **ptp, *tmpp;
     Tree t;
 
+    reserve_workspace(d);
     if (d==2) {
         t.deg = 2;
         t.length = ADIFF(x[0], x[1]) + ADIFF(y[0], y[1]);
-        t.branch = (Branch *) malloc(2*sizeof(Branch));
+        t.branch = ws.branch;
         t.branch[0].x = x[0];
         t.branch[0].y = y[0];
         t.branch[0].n = 1;
@@ -586,11 +785,11 @@ Tree flute(int d, DTYPE x[], DTYPE y[], int acc)
         t.branch[1].n = 1;
     }
     else {
-        xs = (DTYPE *)malloc(sizeof(DTYPE)*(d));
-        ys = (DTYPE *)malloc(sizeof(DTYPE)*(d));
-        s = (int *)malloc(sizeof(int)*(d));
-        pt = (struct point *)malloc(sizeof(struct point)*(d+1));
-        ptp = (struct point **)malloc(sizeof(struct point*)*(d+1));
+        xs = ws.xs;
+        ys = ws.ys;
+        s = ws.s;
+        pt = ws.pt;
+        ptp = ws.ptp;
 
         for (i=0; i<d; i++) {
             pt[i].x = x[i];
@@ -661,13 +860,15 @@ Tree flute(int d, DTYPE x[], DTYPE y[], int acc)
             }
         }
 
-        t = flutes(d, xs, ys, s, acc);
-
-        free(xs);
-        free(ys);
-        free(s);
-        free(pt);
-        free(ptp);
+        if (d<=D && REMOVE_DUPLICATE_PIN==0) {
+            t = flutes_LD_into(d, xs, ys, s, ws.branch);
+        } else {
+            // higher degrees merge and free intermediate trees internally
+            t = flutes(d, xs, ys, s, acc);
+            memcpy(ws.branch, t.branch, (2*t.deg-2)*sizeof(Branch));
+            free(t.branch);
+            t.branch = ws.branch;
+        }
     }
 
     return t;
@@ -707,8 +908,111 @@ Tree flutes_RDP(int d, DTYPE xs[], DTYPE ys[], int s[], int acc)
     return flutes_ALLD(d, xs, ys, s, acc);
 }
 
+// Rectilinear minimum spanning tree of the 4 <= d <= D pins, used by flutes_LD() when the LUT
+// has no POST topologies. flutes_MD() merges trees at their pins, so the result keeps the shape
+// of a LUT tree: the pins are leaves and the d-2 Steiner nodes have degree 3. Every pin of the
+// spanning tree gets a chain of Steiner nodes at its own location, which links the pin, its
+// children and its parent, so the wirelength is that of the spanning tree.
+static DTYPE spanning_tree(int d, DTYPE xs[], DTYPE ys[], int s[], Branch *branch)
+{
+    DTYPE dist[D], len = 0, l;
+    int parent[D], done[D], order[D], up[D], attach[D+1], adj[2*D-2][3], deg[2*D-2], queue[2*D-2];
+    int i, j, k, m, n, v, a, next = d, head, tail;
+
+#define LINK(u, w) (adj[u][deg[u]++] = (w), adj[w][deg[w]++] = (u))
+    // Prim's algorithm from pin 0
+    for (i=0; i<d; i++) {
+        branch[i].x = xs[s[i]];
+        branch[i].y = ys[i];
+        dist[i] = ADIFF(branch[i].x, branch[0].x) + ADIFF(branch[i].y, branch[0].y);
+        parent[i] = 0;
+        done[i] = 0;
+    }
+    parent[0] = -1;
+    done[0] = 1;
+    for (k=1; k<d; k++) {
+        j = -1;
+        for (i=1; i<d; i++)
+            if (!done[i] && (j < 0 || dist[i] < dist[j]))
+                j = i;
+        done[j] = 1;
+        len += dist[j];
+        for (i=1; i<d; i++) {
+            l = ADIFF(branch[i].x, branch[j].x) + ADIFF(branch[i].y, branch[j].y);
+            if (!done[i] && l < dist[i]) {
+                dist[i] = l;
+                parent[i] = j;
+            }
+        }
+    }
+
+    // Pins in breadth-first order of the spanning tree, so that the reverse order visits children first
+    order[0] = 0;
+    for (i=0, n=1; i<n; i++)
+        for (j=1; j<d; j++)
+            if (parent[j] == order[i])
+                order[n++] = j;
+
+    // The pin, its children and its parent are the m attachments of a chain of m-2 Steiner nodes:
+    // two attachments on each end, one on every node in between. up[] is where the parent attaches.
+    for (i=0; i<2*d-2; i++) deg[i] = 0;
+    for (k=d-1; k>=0; k--) {
+        v = order[k];
+        m = 0;
+        attach[m++] = v;
+        for (j=1; j<d; j++)
+            if (parent[j] == v)
+                attach[m++] = up[j];
+        if (parent[v] >= 0)
+            attach[m++] = -1;
+        if (m == 2) {  // a leaf of the spanning tree, or a root with one child
+            if (parent[v] >= 0)
+                up[v] = v;
+            else
+                LINK(attach[0], attach[1]);
+            continue;
+        }
+        for (i=0; i<m; i++) {
+            a = next + (i == 0 ? 0 : i == m-1 ? m-3 : i-1);
+            if (attach[i] >= 0)
+                LINK(a, attach[i]);
+            else
+                up[v] = a;
+        }
+        for (i=next; i<next+m-2; i++) {
+            branch[i].x = branch[v].x;
+            branch[i].y = branch[v].y;
+            if (i+1 < next+m-2)
+                LINK(i, i+1);
+        }
+        next += m-2;
+    }
+#undef LINK
+
+    // Orient the tree towards Steiner node d
+    for (i=0; i<2*d-2; i++) branch[i].n = -1;
+    branch[d].n = d;
+    queue[0] = d;
+    for (head=0, tail=1; head<tail; head++) {
+        v = queue[head];
+        for (i=0; i<deg[v]; i++) {
+            a = adj[v][i];
+            if (branch[a].n < 0) {
+                branch[a].n = v;
+                queue[tail++] = a;
+            }
+        }
+    }
+    return len;
+}
+
 // For low-degree, i.e., 2 <= d <= D
 Tree flutes_LD(int d, DTYPE xs[], DTYPE ys[], int s[])
+{
+    return flutes_LD_into(d, xs, ys, s, (Branch *) malloc((2*d-2)*sizeof(Branch)));
+}
+
+static Tree flutes_LD_into(int d, DTYPE xs[], DTYPE ys[], int s[], Branch *branch)
 {
     int k, pi, i, j;
     struct csoln *rlist, *bestrlist;
@@ -718,7 +1022,7 @@ Tree flutes_LD(int d, DTYPE xs[], DTYPE ys[], int s[])
     Tree t;
 
     t.deg = d;
-    t.branch = (Branch *) malloc((2*d-2)*sizeof(Branch));
+    t.branch = branch;
     if (d == 2) {
         minl = xs[1]-xs[0]+ys[1]-ys[0];
         t.branch[0].x = xs[s[0]];
@@ -743,6 +1047,9 @@ Tree flutes_LD(int d, DTYPE xs[], DTYPE ys[], int s[])
         t.branch[3].y = ys[1];
         t.branch[3].n = 3;
     }
+    else if (!lut_topologies) {
+        minl = spanning_tree(d, xs, ys, s, t.branch);
+    }
     else {
         k = 0;
         if (s[0] < s[2]) k++;
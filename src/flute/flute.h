@@ -17,9 +17,10 @@
 /*  User-Callable Functions  */
 /*****************************/
 // void readLUT();
+// void readLUTFiles(const char *powvfile, const char *postfile);
 // DTYPE flute_wl(int d, DTYPE x[], DTYPE y[], int acc);
 // DTYPE flutes_wl(int d, DTYPE xs[], DTYPE ys[], int s[], int acc);
-// Tree flute(int d, DTYPE x[], DTYPE y[], int acc);
+// Tree flute(int d, DTYPE x[], DTYPE y[], int acc);   // reentrant, branches owned by the calling thread
 // Tree flutes(int d, DTYPE xs[], DTYPE ys[], int s[], int acc);
 // DTYPE wirelength(Tree t);
 // void printtree(Tree t);
@@ -29,10 +30,11 @@
 /*************************************/
 /* Internal Parameters and Functions */
 /*************************************/
-#define POWVFILE "/home/b09901066/ISPD-NTUEE/NTUGR/src/flute/POWV9.dat"
-#define POSTFILE "/home/b09901066/ISPD-NTUEE/NTUGR/src/flute/POST9.dat"  
-// #define POWVFILE "POWV9.dat"        // LUT for POWV (Wirelength Vector)
-// #define POSTFILE "POST9.dat"        // LUT for POST (Steiner Tree)
+#ifndef FLUTE_LUT_DIR               // Set by CMake, read when no LUT with Steiner topologies was embedded
+#define FLUTE_LUT_DIR "."
+#endif
+#define POWVFILE FLUTE_LUT_DIR "/POWV9.dat"   // LUT for POWV (Wirelength Vector)
+#define POSTFILE FLUTE_LUT_DIR "/POST9.dat"   // LUT for POST (Steiner Tree)
 #define D 9                         // LUT is used for d <= D, D <= 9
 #define TAU(A) (8+1.3*(A))
 #define D1(A) (25+120/((A)*(A)))     // flute_mr is used for D1 < d <= D2
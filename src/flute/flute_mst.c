@@ -22,10 +22,10 @@
 #define MAXT (d/5)
 #endif
 
-int D3=INFNTY;
+_Thread_local int D3=INFNTY;
 
-int FIRST_ROUND=2; // note that num of total rounds = 1+FIRST_ROUND
-int EARLY_QUIT_CRITERIA=1;
+_Thread_local int FIRST_ROUND=2; // note that num of total rounds = 1+FIRST_ROUND
+_Thread_local int EARLY_QUIT_CRITERIA=1;
 
 #define DEFAULT_QSIZE (3+flute_min(d,1000))
 
@@ -33,10 +33,10 @@ int EARLY_QUIT_CRITERIA=1;
 #if USE_HASHING
 #define new_ht 1
 //int new_ht=1;
-dl_t ht[D2M+1]; // hash table of subtrees indexed by degree
+_Thread_local dl_t ht[D2M+1]; // hash table of subtrees indexed by degree
 #endif
 
-unsigned int curr_mark=0;
+_Thread_local unsigned int curr_mark=0;
 
 Tree wmergetree(Tree t1, Tree t2, int *order1, int *order2, DTYPE cx, DTYPE cy, int acc);
 Tree xmergetree(Tree t1, Tree t2, int *order1, int *order2, DTYPE cx, DTYPE cy);
@@ -58,13 +58,13 @@ void enqueue(int **q, int e)
 }
 
 #define MAX_HEAP_SIZE (MAXD*2)
-DTYPE **hdist;
+_Thread_local DTYPE **hdist;
 typedef struct node_pair_s { // pair of nodes representing an edge
   int node1, node2;
 } node_pair;
-node_pair *heap; //heap[MAXD*MAXD];
-int heap_size=0;
-int max_heap_size = MAX_HEAP_SIZE;
+_Thread_local node_pair *heap; //heap[MAXD*MAXD];
+_Thread_local int heap_size=0;
+_Thread_local int max_heap_size = MAX_HEAP_SIZE;
 
 int in_heap_order(int e1, int e2)
 {
@@ -137,10 +137,11 @@ void init_param()
 {
   int i;
 
-  heap = (node_pair*)malloc(sizeof(node_pair)*(max_heap_size+1));
+  if (!heap)  // the heap is per thread
+    heap = (node_pair*)malloc(sizeof(node_pair)*(max_heap_size+1));
 }
 
-Tree reftree;  // reference for qsort
+_Thread_local Tree reftree;  // reference for qsort
 int cmp_branch(const void *a, const void *b) {
   int n;
   DTYPE x1, x2, x3;
@@ -408,6 +409,7 @@ void mst_from_heap(int d, DTYPE **dist, int node1, int node2, int **nb,
   int i, j, itr, idx;
   node_pair e;
 
+  init_param();
   hdist = dist;
   heap_size=0;
 
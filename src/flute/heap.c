@@ -9,9 +9,9 @@
 #include "err.h"
 
 
-Heap*   _heap = (Heap*)NULL;
-long    _max_heap_size = 0;
-long    _heap_size = 0;
+_Thread_local Heap*   _heap = (Heap*)NULL;
+_Thread_local long    _max_heap_size = 0;
+_Thread_local long    _heap_size = 0;
 
 /****************************************************************************/
 /*
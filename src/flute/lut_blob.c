@@ -0,0 +1,24 @@
+#include <stddef.h>
+
+// The binary LUT generated at build time by lutgen, see readLUT() in flute.c
+#ifdef FLUTE_LUT_BLOB
+__asm__(".section .rodata\n"
+        ".balign 64\n"
+        "flute_lut_begin:\n"
+        ".incbin \"" FLUTE_LUT_BLOB "\"\n"
+        "flute_lut_end:\n"
+        ".previous\n");
+extern const unsigned char flute_lut_begin[], flute_lut_end[];
+
+const unsigned char *lut_blob(size_t *size)
+{
+    *size = flute_lut_end - flute_lut_begin;
+    return flute_lut_begin;
+}
+#else
+const unsigned char *lut_blob(size_t *size)
+{
+    *size = 0;
+    return NULL;
+}
+#endif
@@ -0,0 +1,26 @@
+#include <stdio.h>
+#include <stddef.h>
+
+// Build-time tool: converts the text POWV/POST tables into the binary LUT that
+// lut_blob.c embeds into the flute library.
+//   lutgen POWV9.dat [POST9.dat] flute_lut.bin
+// Without POST9.dat the LUT holds no Steiner topologies, see parseLUT() in flute.c.
+
+void readLUTFiles(const char *powvfile, const char *postfile);
+int writeLUTBlob(const char *file);
+
+const unsigned char *lut_blob(size_t *size)
+{
+    *size = 0;
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3 && argc != 4) {
+        printf("Usage: %s POWV9.dat [POST9.dat] output\n", argv[0]);
+        return 1;
+    }
+    readLUTFiles(argv[1], argc == 4 ? argv[2] : NULL);
+    return writeLUTBlob(argv[argc - 1]) ? 0 : 1;
+}
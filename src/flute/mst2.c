@@ -40,7 +40,7 @@ void  mst2
   long  d;
   long  oct;
   long  root = 0;
-  extern  nn_array*  nn;
+  extern _Thread_local nn_array*  nn;
 
 //  brute_force_nearest_neighbors( n, pt, nn );
   dq_nearest_neighbors( n, pt, nn );
@@ -11,18 +11,18 @@ long  octant
   Point  to
 );
 
-static Point* _pt;
+static _Thread_local Point* _pt;
 
 /***************************************************************************/
 /*
   For efficiency purposes auxiliary arrays are allocated as globals 
 */
 
-long    max_arrays_size = 0;
-nn_array*  nn   = (nn_array*)NULL;
-Point*  sheared = (Point*)NULL;
-long*  sorted   = (long*)NULL;
-long*  aux      = (long*)NULL;  
+_Thread_local long    max_arrays_size = 0;
+_Thread_local nn_array*  nn   = (nn_array*)NULL;
+_Thread_local Point*  sheared = (Point*)NULL;
+_Thread_local long*  sorted   = (long*)NULL;
+_Thread_local long*  aux      = (long*)NULL;  
 
 /***************************************************************************/
 /*
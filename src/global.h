@@ -35,19 +35,48 @@ struct Parameters {
     std::string cap_file;
     std::string net_file;
     std::string out_file;
+    std::string dump_snapshot_file; // --dump-snapshot: write the parsed design to a binary snapshot
+    std::string load_snapshot_file; // --load-snapshot: read the design from a binary snapshot instead of CAP/NET
+    std::string flute_lut_dir;      // --flute-lut: read POWV9.dat and POST9.dat from this directory instead of the embedded tables
 
     // Global routing parameters
     const int num_threads = 8;
+    bool optimistic_routing = false; // --optimistic: pattern route without the conflict graph, validate before commit (nondeterministic)
     const bool stage2 = true;
-    const bool stage3 = false;
+    bool batched_rerouting = false;  // --batch-reroute: stage 2 in batches of independent nets, refreshing the congestion view in between
+    bool stage3 = false;                   // --stage3: maze route the nets still overflowing after stage 2
+    int maze_margin = -1;                  // --maze-margin <n>: stage 3 graphs cover the bounding box plus n gcells (-1: the whole grid)
+    bool maze_astar = false;               // --maze-astar: stage 3 searches with A* instead of Dijkstra
+    const double maze_margin_growth = 2.0; // factor applied to the margin when a stage 3 net is cut off by it
+    const int maze_batches = 16;           // stage 3 refreshes the maze wire costs from the demand this many times
+    int negotiation_rounds = 0;                    // --negotiate <n>: rip-up and reroute rounds with history costs after stage 2
+    const double history_cost_step = 0.3;          // history cost per unit of overflow added in the first round, times OFWeight
+    const double history_cost_growth = 1.5;        // factor applied to the step after every round
+    const double negotiation_min_improvement = 0.01; // stop when a round reduces the total overflow by less than this fraction
+    const double negotiation_round_time = 60.0;    // seconds per round; nets not rerouted by then keep their routes
+
+    bool pattern_l_shapes = false;     // --patterns l: both L-shapes instead of one (also implied by z and s)
+    bool pattern_z_shapes = false;     // --patterns z: Z-shapes through the bounding box
+    bool pattern_staircases = false;   // --patterns s: monotonic staircases with three bends
+    const int pattern_max_bends = 4;   // Z-shape / staircase bend positions tried per direction and 2-pin connection
+    const int pattern_max_dag_nodes = 4000; // beyond this many DAG nodes a net only gets one L-shape per connection
 
     const int min_routing_layer = 1;
     const double max_detour_ratio = 0.1; // May change
     const int target_detour_count = 10;  // May change
     const double via_multiplier = 1.5;  // Adjustable (e.g., 1.0, 1.5, 2.0)
 
+    const bool flute_cache = true;          // share FLUTE trees between nets with the same pin pattern
+    const int flute_cache_max_degree = 32;  // larger nets are not cached
+
     const double cost_logistic_slope1 = 1.5;
     const double cost_logistic_slope2 = 0.5;
+    const bool wire_cost_cache = true;            // O(1) segment wire costs from per-track prefix sums
+    bool validate_wire_cost_cache = false;        // --validate-wire-cost-cache: check every cached segment cost against the exact sum (slow)
+    const bool linear_layer_dp = false;           // running minima for nodes with at most one child; equal optima up to rounding, not bit-identical
+    const bool check_layer_dp = false;            // with linear_layer_dp, also run the pairwise layer assignment and report differences (slow)
+    const bool via_cost_cache = true;             // via stack costs per gcell, reused until a demand there changes
+    bool exact_cost = false; // --exact-cost: std::exp instead of the fast approximation and no wire cost cache (sign-off runs)
     // const double maze_logistic_slope = 0.5;
     const bool write_heatmap = false;
     const bool write_capacity = false;
@@ -70,6 +99,42 @@ struct Parameters {
                 net_file = argv[++i];
             } else if (strcmp(argv[i], "-output") == 0) {
                 out_file = argv[++i];
+            } else if (strcmp(argv[i], "--dump-snapshot") == 0) {
+                dump_snapshot_file = argv[++i];
+            } else if (strcmp(argv[i], "--load-snapshot") == 0) {
+                load_snapshot_file = argv[++i];
+            } else if (strcmp(argv[i], "--flute-lut") == 0) {
+                flute_lut_dir = argv[++i];
+            } else if (strcmp(argv[i], "--optimistic") == 0) {
+                optimistic_routing = true;
+            } else if (strcmp(argv[i], "--batch-reroute") == 0) {
+                batched_rerouting = true;
+            } else if (strcmp(argv[i], "--negotiate") == 0) {
+                negotiation_rounds = std::stoi(argv[++i]);
+            } else if (strcmp(argv[i], "--patterns") == 0) {
+                // Comma-separated list of l, z and s
+                std::stringstream list(argv[++i]);
+                std::string pattern;
+                while (std::getline(list, pattern, ',')) {
+                    if (pattern == "l")
+                        pattern_l_shapes = true;
+                    else if (pattern == "z")
+                        pattern_z_shapes = true;
+                    else if (pattern == "s")
+                        pattern_staircases = true;
+                    else
+                        std::cerr << "[WARNING] Unrecognized pattern: " << pattern << '\n';
+                }
+            } else if (strcmp(argv[i], "--stage3") == 0) {
+                stage3 = true;
+            } else if (strcmp(argv[i], "--maze-margin") == 0) {
+                maze_margin = std::stoi(argv[++i]);
+            } else if (strcmp(argv[i], "--maze-astar") == 0) {
+                maze_astar = true;
+            } else if (strcmp(argv[i], "--exact-cost") == 0) {
+                exact_cost = true;
+            } else if (strcmp(argv[i], "--validate-wire-cost-cache") == 0) {
+                validate_wire_cost_cache = true;
             } else if (strcmp(argv[i], "library") == 0 || strcmp(argv[i], "-def") == 0 ||
                        strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "-sdc") == 0) {
                 // Skip unrecognized or unnecessary arguments
@@ -86,6 +151,29 @@ struct Parameters {
         std::cout << "Cap File : " << cap_file << '\n';
         std::cout << "Net File : " << net_file << '\n';
         std::cout << "Output   : " << out_file << '\n';
+        if (!load_snapshot_file.empty())
+            std::cout << "Snapshot : " << load_snapshot_file << " (load)\n";
+        if (!dump_snapshot_file.empty())
+            std::cout << "Snapshot : " << dump_snapshot_file << " (dump)\n";
+        if (!flute_lut_dir.empty())
+            std::cout << "FLUTE LUT: " << flute_lut_dir << '\n';
+        if (exact_cost)
+            std::cout << "Cost     : exact exp, no wire cost cache\n";
+        else if (validate_wire_cost_cache)
+            std::cout << "Cost     : validating the wire cost cache\n";
+        if (optimistic_routing)
+            std::cout << "Routing  : optimistic\n";
+        else if (batched_rerouting)
+            std::cout << "Routing  : batched rerouting\n";
+        if (negotiation_rounds > 0)
+            std::cout << "Negotiate: " << negotiation_rounds << " rounds\n";
+        if (pattern_l_shapes || pattern_z_shapes || pattern_staircases)
+            std::cout << "Patterns : L" << (pattern_z_shapes ? ", Z" : "") << (pattern_staircases ? ", staircase" : "") << '\n';
+        if (stage3)
+            std::cout << "Stage 3  : maze routing" << (maze_astar ? " (A*)" : "") << ", "
+                      << (maze_margin >= 0 ? "bounding box + " + std::to_string(maze_margin) + " gcells" : "whole grid") << '\n';
+        else if (maze_margin >= 0 || maze_astar)
+            std::cerr << "[WARNING] --maze-margin and --maze-astar have no effect without --stage3\n";
         std::cout << "=====================================\n";
     }
 };
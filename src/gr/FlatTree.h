@@ -0,0 +1,48 @@
+#pragma once
+#include "../global.h"
+
+// Tree in one flat preorder array, the layout of both GRTree and SteinerTree. The children of node i start at
+// i + 1, and each further child follows the subtree of the previous one, so subtree sizes serve as child offsets
+// and the whole tree is a single allocation. Trees are built in preorder: addNode() appends a node to a parent
+// whose subtree is still being built, and closeNode() ends a node once all of its descendants are added.
+// Visitors are templates and inline into the callers.
+template <typename Point>
+class FlatTree {
+public:
+    struct Node: public Point {
+        int numChildren = 0;
+        int subtreeSize = 1;  // including the node itself
+        Node(const Point& point): Point(point) {}
+    };
+
+    inline bool empty() const { return nodes.empty(); }
+    inline int size() const { return nodes.size(); }
+    inline const Node& operator[](const int index) const { return nodes[index]; }
+
+    void clear() { nodes.clear(); }
+    void reserve(const int numNodes) { nodes.reserve(numNodes); }
+    int addNode(const Point& point, const int parent = -1) {
+        if (parent != -1) nodes[parent].numChildren++;
+        nodes.emplace_back(point);
+        return nodes.size() - 1;
+    }
+    void closeNode(const int index) { nodes[index].subtreeSize = nodes.size() - index; }
+
+    template <typename Visit>  // visit(childIndex)
+    inline void forEachChild(const int index, Visit visit) const {
+        int child = index + 1;
+        for (int i = 0; i < nodes[index].numChildren; i++) {
+            visit(child);
+            child += nodes[child].subtreeSize;
+        }
+    }
+    template <typename Visit>  // visit(node, child) for every edge, parents in preorder
+    inline void forEachEdge(Visit visit) const {
+        for (int index = 0; index < (int)nodes.size(); index++) {
+            forEachChild(index, [&](int child) { visit(nodes[index], nodes[child]); });
+        }
+    }
+
+protected:
+    vector<Node> nodes;
+};
@@ -0,0 +1,64 @@
+#include "FluteCache.h"
+
+extern "C" {
+Tree flute(int d, DTYPE x[], DTYPE y[], int acc);
+}
+
+const Branch* FluteCache::getTree(const int degree, int xs[], int ys[]) {
+    if (degree < MinDegree || degree > maxDegree)
+        return flute(degree, xs, ys, ACCURACY).branch;
+
+    static thread_local vector<int> pattern;
+    static thread_local vector<Branch> branches;
+    const int numBranches = degree + degree - 2;
+    const int minX = *std::min_element(xs, xs + degree);
+    const int minY = *std::min_element(ys, ys + degree);
+    pattern.resize(degree * 2);
+    uint64_t hash = degree;
+    for (int i = 0; i < degree; i++) {
+        pattern[i * 2] = xs[i] - minX;
+        pattern[i * 2 + 1] = ys[i] - minY;
+        for (int value : {pattern[i * 2], pattern[i * 2 + 1]}) {
+            hash ^= (uint64_t)value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+        }
+    }
+    numLookups.fetch_add(1, std::memory_order_relaxed);
+
+    Shard& shard = shards[hash % NumShards];
+    branches.resize(numBranches);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(hash);
+        if (it != shard.entries.end()) {
+            for (const Entry& entry : it->second) {
+                if (entry.pattern != pattern)
+                    continue;
+                numHits.fetch_add(1, std::memory_order_relaxed);
+                for (int i = 0; i < numBranches; i++) {
+                    branches[i] = entry.branches[i];
+                    branches[i].x += minX;
+                    branches[i].y += minY;
+                }
+                return branches.data();
+            }
+        }
+    }
+
+    Tree tree = flute(degree, xs, ys, ACCURACY);
+    Entry entry;
+    entry.pattern = pattern;
+    entry.branches.assign(tree.branch, tree.branch + numBranches);
+    for (Branch& branch : entry.branches) {
+        branch.x -= minX;
+        branch.y -= minY;
+    }
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        vector<Entry>& entries = shard.entries[hash];
+        bool found = false;  // another thread may have inserted the same pattern meanwhile
+        for (const Entry& other : entries) found = found || other.pattern == pattern;
+        if (!found)
+            entries.push_back(std::move(entry));
+    }
+    return tree.branch;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include "../global.h"
+#include "../flute/flute.h"
+
+// Concurrent cache in front of flute() for nets with the same pin pattern (bus bits, clock tree leaves, repeated
+// macros). The key is the degree and the pin coordinates relative to the lower-left corner of the pins, in the
+// order given; callers sort the pins so that every translate of a pattern produces the same key. For sorted pins
+// this key carries exactly the rank order and the gaps between consecutive coordinates that flutes_LD() works
+// from: each determines the other. A rank-only key is not enough: FLUTE picks among the LUT solutions by the gaps,
+// so it would return trees built for other gaps. Trees are stored relative to the same corner and re-instantiated
+// at the querying net.
+//
+// The table is split into shards, each behind its own mutex, so that threads building Steiner trees in parallel
+// rarely wait for each other.
+class FluteCache {
+public:
+    FluteCache(const int _maxDegree): maxDegree(_maxDegree) {}
+
+    // Same tree as flute(degree, xs, ys, ACCURACY); the branches stay valid until the next call on this thread
+    const Branch* getTree(const int degree, int xs[], int ys[]);
+
+    uint64_t getNumHits() const { return numHits.load(std::memory_order_relaxed); }
+    uint64_t getNumLookups() const { return numLookups.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr int NumShards = 64;
+    static constexpr int MinDegree = 4;  // smaller trees are cheaper to build than to look up
+
+    struct Entry {
+        vector<int> pattern;      // x0, y0, x1, y1, ... relative to the lower-left corner
+        vector<Branch> branches;  // relative to the lower-left corner
+    };
+    struct Shard {
+        std::mutex mutex;
+        robin_hood::unordered_map<uint64_t, vector<Entry>> entries;  // pattern hash -> entries
+    };
+
+    const int maxDegree;  // larger nets rarely repeat and are not cached
+    Shard shards[NumShards];
+    std::atomic<uint64_t> numHits{0};
+    std::atomic<uint64_t> numLookups{0};
+};
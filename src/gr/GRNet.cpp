@@ -31,48 +31,41 @@ GRNet::GRNet(const Net& baseNet, const Design& design, const GridGraph& gridGrap
 }
 
 void GRNet::getGuides() {
-    if (!routingTree)
+    if (routingTree.empty())
         return;
 
     vector<vector<int>> guide;
 
     // function addGuideSegment, input is node, child, guide, add the guide segment to guide
-    auto addGuideSegment = [&](vector<vector<int>>& guide, std::shared_ptr<GRTreeNode> node, std::shared_ptr<GRTreeNode> child) {
+    auto addGuideSegment = [&](vector<vector<int>>& guide, const GRPoint& node, const GRPoint& child) {
         vector<int> vec;
         vec.reserve(6);
-        vec.emplace_back(min(node->x, child->x));
-        vec.emplace_back(min(node->y, child->y));
-        vec.emplace_back(min(node->layerIdx, child->layerIdx));
-        vec.emplace_back(max(node->x, child->x));
-        vec.emplace_back(max(node->y, child->y));
-        vec.emplace_back(max(node->layerIdx, child->layerIdx));
+        vec.emplace_back(min(node.x, child.x));
+        vec.emplace_back(min(node.y, child.y));
+        vec.emplace_back(min(node.layerIdx, child.layerIdx));
+        vec.emplace_back(max(node.x, child.x));
+        vec.emplace_back(max(node.y, child.y));
+        vec.emplace_back(max(node.layerIdx, child.layerIdx));
         guide.push_back(vec);
     };
 
-    GRTreeNode::preorder(routingTree, [&](std::shared_ptr<GRTreeNode> node) {
-        for (const auto& child : node->children) {
-            // assign zl, zh for node and child, zl is the lower layer, zh is the higher layer
-            int zl = min(node->layerIdx, child->layerIdx);
-            int zh = max(node->layerIdx, child->layerIdx);
+    routingTree.forEachEdge([&](const GRPoint& node, const GRPoint& child) {
+        // assign zl, zh for node and child, zl is the lower layer, zh is the higher layer
+        int zl = min(node.layerIdx, child.layerIdx);
+        int zh = max(node.layerIdx, child.layerIdx);
 
-            if (node->x == child->x && node->y == child->y && zl == zh) {
-                // cout << "Warning: node and child are the same" << endl;
-                continue;
-            }
-            if (node->x == child->x && node->y == child->y && zh != zl + 1) {
-                // split the segment into multiple segments
-                for (int z = zl; z < zh; z++) {
-                    // create nodes for the split segments from z to z+1
-                    std::shared_ptr<GRTreeNode> node1 = std::make_shared<GRTreeNode>(*node);
-                    node1->layerIdx = z;
-                    std::shared_ptr<GRTreeNode> node2 = std::make_shared<GRTreeNode>(*node);
-                    node2->layerIdx = z + 1;
-                    // add the guide segment
-                    addGuideSegment(guide, node1, node2);
-                }
-            } else {
-                addGuideSegment(guide, node, child);
+        if (node.x == child.x && node.y == child.y && zl == zh) {
+            // cout << "Warning: node and child are the same" << endl;
+            return;
+        }
+        if (node.x == child.x && node.y == child.y && zh != zl + 1) {
+            // split the segment into multiple segments
+            for (int z = zl; z < zh; z++) {
+                // add the guide segment from z to z+1
+                addGuideSegment(guide, GRPoint(z, node.x, node.y), GRPoint(z + 1, node.x, node.y));
             }
+        } else {
+            addGuideSegment(guide, node, child);
         }
     });
     // check if the guide has same elements
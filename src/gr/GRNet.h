@@ -12,10 +12,10 @@ public:
     int getNumPins() const { return pinAccessPoints.size(); }
     const vector<vector<GRPoint>>& getPinAccessPoints() const { return pinAccessPoints; }
     const utils::BoxT<int>& getBoundingBox() const { return boundingBox; }
-    const std::shared_ptr<GRTreeNode>& getRoutingTree() const { return routingTree; }
+    const GRTree& getRoutingTree() const { return routingTree; }
     
-    void setRoutingTree(std::shared_ptr<GRTreeNode> tree) { routingTree = tree; }
-    void clearRoutingTree() { routingTree = nullptr; }
+    void setRoutingTree(GRTree&& tree) { routingTree = std::move(tree); }
+    void clearRoutingTree() { routingTree = GRTree(); }
     void getGuides();
     
     string guide_string;
@@ -24,5 +24,5 @@ public:
     std::string name;
     vector<vector<GRPoint>> pinAccessPoints; // pinAccessPoints[pinIndex][accessPointIndex]
     utils::BoxT<int> boundingBox;
-    std::shared_ptr<GRTreeNode> routingTree;
+    GRTree routingTree;
 };
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include "../global.h"
+#include "FlatTree.h"
 
 class GRPoint: public utils::PointT<int> {
 public:
@@ -13,12 +14,5 @@ public:
     
 };
 
-class GRTreeNode: public GRPoint {
-public:
-    vector<std::shared_ptr<GRTreeNode>> children;
-    
-    GRTreeNode(int l, int _x, int _y): GRPoint(l, _x, _y) {}
-    GRTreeNode(const GRPoint& point): GRPoint(point) {}
-    static void preorder(std::shared_ptr<GRTreeNode> node, std::function<void(std::shared_ptr<GRTreeNode>)> visit);
-    // static void print(std::shared_ptr<GRTreeNode> node);
-};
\ No newline at end of file
+// Routing tree of a net, see FlatTree
+using GRTree = FlatTree<GRPoint>;
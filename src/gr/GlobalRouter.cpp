@@ -2,16 +2,18 @@
 #include "GlobalRouter.h"
 #include <chrono>
 #include "MazeRoute.h"
+#include "NetScheduler.h"
 #include "PatternRoute.h"
 
 GlobalRouter::GlobalRouter(const Design& design, const Parameters& params)
-    : gridGraph(design, params), parameters(params) {
+    : gridGraph(design, params), parameters(params), fluteCache(params.flute_cache_max_degree) {
     // Instantiate the global routing netlist
     const size_t numNets = design.netlist.nets.size();
     nets.reserve(numNets);
     for (const Net& baseNet : design.netlist.nets) {
         nets.emplace_back(baseNet, design, gridGraph);
     }
+    steinerTrees.resize(numNets);
 }
 
 void GlobalRouter::route() {
@@ -26,7 +28,7 @@ void GlobalRouter::route() {
         netIndices.emplace_back(net.getIndex());
     }
 
-    PatternRoute::readFluteLUT();
+    PatternRoute::readFluteLUT(parameters.flute_lut_dir);
 
     // Stage 1
     n1 = netIndices.size();
@@ -38,12 +40,7 @@ void GlobalRouter::route() {
     std::cout << "======================" << std::endl;
 
     if (stage2){    
-        netIndices.clear();
-        for (const auto& net : nets) {
-            if (gridGraph.checkOverflow(net.getRoutingTree(), 0) > 0) {
-                netIndices.push_back(net.getIndex());
-            }
-        }
+        collectOverflowingNets(0, netIndices);
         std::cout << "[INFO] " << netIndices.size() << " / " << nets.size() << " nets have overflows after Stage 1." << std::endl;
         std::cout << "======================" << std::endl;
 
@@ -59,13 +56,17 @@ void GlobalRouter::route() {
         }
     }
 
+    if (parameters.negotiation_rounds > 0) {
+        auto t = std::chrono::high_resolution_clock::now();
+        stageNegotiatedRouting(threadNum);
+        std::cout << "[INFO] Negotiated routing completed in "
+                  << std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t).count()
+                  << " seconds." << std::endl;
+        std::cout << "======================" << std::endl;
+    }
+
     if (stage3){
-        netIndices.clear();
-        for (const auto& net : nets) {
-            if (gridGraph.checkOverflow(net.getRoutingTree(), 2) > 0) {
-                netIndices.push_back(net.getIndex());
-            }
-        }
+        collectOverflowingNets(2, netIndices);
         std::cout << "[INFO] " << netIndices.size() << " / " << nets.size() << " nets have overflows after Stage 2." << std::endl;
         std::cout << "======================" << std::endl;
 
@@ -73,7 +74,7 @@ void GlobalRouter::route() {
         if (!netIndices.empty()) {
             n3 = netIndices.size();
             auto t3 = std::chrono::high_resolution_clock::now();
-            stageMazeRouting(netIndices);
+            stageMazeRouting(netIndices, threadNum);
             std::cout << "[INFO] Stage 3 completed in "
                     << std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t3).count()
                     << " seconds." << std::endl;
@@ -91,106 +92,200 @@ void GlobalRouter::route() {
 
 void GlobalRouter::stagePatternRouting(std::vector<int>& netIndices, int threadNum, int& n1) {
     std::cout << "[INFO] Stage 1: Pattern Routing" << std::endl;
+    constructSteinerTrees(netIndices);
     GridGraphView<bool> congestionView;
     gridGraph.extractCongestionView(congestionView);
 
     sortNetIndices(netIndices);
 
-    std::vector<std::vector<int>> nonoverlapNetIndices(threadNum + 1);
-    separateNetIndices(netIndices, nonoverlapNetIndices);
-
-    for (size_t i = 0; i < nonoverlapNetIndices.size(); ++i) {
-        std::cout << "[INFO] Thread " << i << " size: " << nonoverlapNetIndices[i].size() << std::endl;
-    }
-
-    omp_lock_t lock;
-    omp_init_lock(&lock);
-
-#pragma omp parallel for
-    for (int i = 0; i < threadNum; ++i) {
-        for (int j : nonoverlapNetIndices[i]) {
-            PatternRoute patternRoute(nets[j], gridGraph, parameters);
-            omp_set_lock(&lock);
-            patternRoute.constructSteinerTree();
-            omp_unset_lock(&lock);
-            patternRoute.constructRoutingDAG();
-            patternRoute.run();
-            gridGraph.commitTree(nets[j].getRoutingTree());
-        }
-    }
-    omp_destroy_lock(&lock);
-
-    for (int j : nonoverlapNetIndices[threadNum]) {
-        PatternRoute patternRoute(nets[j], gridGraph, parameters);
-        patternRoute.constructSteinerTree();
+    scheduleNets(netIndices, threadNum, false, [&](int netIndex) {
+        PatternRoute patternRoute(nets[netIndex], gridGraph, parameters);
+        patternRoute.setSteinerTree(steinerTrees[netIndex]);
         patternRoute.constructRoutingDAG();
         patternRoute.run();
-        gridGraph.commitTree(nets[j].getRoutingTree());
-    }
+    });
 }
 
 void GlobalRouter::stagePatternRoutingWithDetours(std::vector<int>& netIndices, int threadNum, int& n2) {
     std::cout << "[INFO] Stage 2: Pattern Routing with Detours" << std::endl;
+    rerouteWithDetours(netIndices, threadNum, std::chrono::steady_clock::time_point::max());
+}
+
+void GlobalRouter::stageNegotiatedRouting(int threadNum) {
+    std::cout << "[INFO] Negotiated Routing" << std::endl;
+    CostT step = parameters.history_cost_step;
+    CapacityT overflow = gridGraph.getTotalOverflow();
+    std::vector<int> netIndices;
+    for (int round = 0; round < parameters.negotiation_rounds; ++round) {
+        auto start = std::chrono::steady_clock::now();
+        collectOverflowingNets(0, netIndices);
+        if (netIndices.empty())
+            break;
+        gridGraph.addHistoryCosts(step);
+        const int numSkipped = rerouteWithDetours(netIndices, threadNum,
+            start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(parameters.negotiation_round_time)));
+        const CapacityT previousOverflow = overflow;
+        overflow = gridGraph.getTotalOverflow();
+        std::cout << "[INFO] Round " << round << ": " << netIndices.size() << " nets rerouted";
+        if (numSkipped > 0)
+            std::cout << " (" << numSkipped << " skipped after the time budget)";
+        std::cout << ", overflow " << previousOverflow << " -> " << overflow << " in "
+                  << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s" << std::endl;
+        if (previousOverflow - overflow < parameters.negotiation_min_improvement * previousOverflow)
+            break;
+        step *= parameters.history_cost_growth;
+    }
+}
+
+int GlobalRouter::rerouteWithDetours(std::vector<int>& netIndices, int threadNum, std::chrono::steady_clock::time_point deadline) {
+    constructSteinerTrees(netIndices);
     GridGraphView<bool> congestionView;
     gridGraph.extractCongestionView(congestionView);
 
     sortNetIndices(netIndices);
 
-    std::vector<std::vector<int>> nonoverlapNetIndices(threadNum + 1);
-    separateNetIndices(netIndices, nonoverlapNetIndices);
-
-    for (size_t i = 0; i < nonoverlapNetIndices.size(); ++i) {
-        std::cout << "[INFO] Thread " << i << " size: " << nonoverlapNetIndices[i].size() << std::endl;
-    }
-
-    omp_lock_t lock;
-    omp_init_lock(&lock);
-
-#pragma omp parallel for
-    for (int i = 0; i < threadNum; ++i) {
-        for (int j : nonoverlapNetIndices[i]) {
-            GRNet& net = nets[j];
-            gridGraph.commitTree(net.getRoutingTree(), true);
-            PatternRoute patternRoute(net, gridGraph, parameters);
-            omp_set_lock(&lock);
-            patternRoute.constructSteinerTree();
-            omp_unset_lock(&lock);
-            patternRoute.constructRoutingDAG();
-            patternRoute.constructDetours(congestionView);
-            patternRoute.run();
-            gridGraph.commitTree(net.getRoutingTree());
+    // Past the deadline routeNet leaves the routing tree as it is, so the net gets its previous route back
+    std::atomic<int> numSkipped(0);
+    scheduleNets(netIndices, threadNum, true, [&](int netIndex) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            numSkipped++;
+            return;
         }
-    }
-    omp_destroy_lock(&lock);
-
-    for (int j : nonoverlapNetIndices[threadNum]) {
-        GRNet& net = nets[j];
-        gridGraph.commitTree(net.getRoutingTree(), true);
-        PatternRoute patternRoute(net, gridGraph, parameters);
-        patternRoute.constructSteinerTree();
+        PatternRoute patternRoute(nets[netIndex], gridGraph, parameters);
+        patternRoute.setSteinerTree(steinerTrees[netIndex]);
         patternRoute.constructRoutingDAG();
         patternRoute.constructDetours(congestionView);
         patternRoute.run();
-        gridGraph.commitTree(net.getRoutingTree());
+    }, &congestionView);
+    return numSkipped;
+}
+
+void GlobalRouter::constructSteinerTrees(const std::vector<int>& netIndices) {
+    auto start = std::chrono::high_resolution_clock::now();
+    const int numNets = netIndices.size();
+    const uint64_t hits = fluteCache.getNumHits(), lookups = fluteCache.getNumLookups();
+    FluteCache* cache = parameters.flute_cache ? &fluteCache : nullptr;
+    int numBuilt = 0;
+#pragma omp parallel for schedule(dynamic, 64) reduction(+ : numBuilt)
+    for (int i = 0; i < numNets; ++i) {
+        const int netIndex = netIndices[i];
+        if (PatternRoute::constructSteinerTree(nets[netIndex], gridGraph, steinerTrees[netIndex], cache))
+            numBuilt++;
+    }
+    std::cout << "[INFO] Steiner trees: " << numBuilt << " built, " << numNets - numBuilt << " reused in "
+              << std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count() << " s" << std::endl;
+    if (cache && fluteCache.getNumLookups() > lookups) {
+        const uint64_t stageHits = fluteCache.getNumHits() - hits, stageLookups = fluteCache.getNumLookups() - lookups;
+        std::cout << "[INFO] FLUTE cache: " << stageHits << " / " << stageLookups << " hits ("
+                  << 100.0 * stageHits / stageLookups << "%)" << std::endl;
     }
 }
 
-void GlobalRouter::stageMazeRouting(std::vector<int>& netIndices) {
+void GlobalRouter::stageMazeRouting(std::vector<int>& netIndices, int threadNum) {
     std::cout << "[INFO] Stage 3: Maze Routing" << std::endl;
+    // The maze searches cost wires by the current demand. Nets are rerouted in parameters.maze_batches batches of the
+    // sorted order: the nets of a batch search the same view in parallel, so their routes do not depend on each other,
+    // and the view is refreshed where the batch changed the demand before the next batch searches.
     GridGraphView<CostT> wireCostView;
     gridGraph.extractWireCostView(wireCostView);
 
     sortNetIndices(netIndices);
-    SparseGrid grid(1, 1, 0, 0);
+    const int netSize = netIndices.size();
+    const int batchSize = std::max((netSize + parameters.maze_batches - 1) / parameters.maze_batches, 1);
+
+    const utils::BoxT<int> die(0, 0, gridGraph.getSize(0) - 1, gridGraph.getSize(1) - 1);
+    std::vector<SteinerTree> mazeTrees(netSize);
+    std::vector<utils::BoxT<int>> extents(netSize);
+    std::vector<int> treeIndex(nets.size(), -1);
+    for (int i = 0; i < netSize; ++i) treeIndex[netIndices[i]] = i;
+    std::vector<GRTree> previousTrees;
+    int64_t numVertices = 0, numExpanded = 0;
+    int numGrown = 0;
+    std::atomic<int> numImproved{0};
+    for (int begin = 0; begin < netSize; begin += batchSize) {
+        const int end = std::min(begin + batchSize, netSize);
+
+        // 1. Maze routing fixes the 2D topology of every net, each one on its own sparse graph. With
+        // parameters.maze_margin, the graph covers the bounding box plus the margin only. The margin grows when the pins
+        // cannot be connected in it, or when the tree leaves the bounding box up to a clipped side, where a cheaper
+        // detour may lie beyond.
+#pragma omp parallel for schedule(dynamic, 1) num_threads(threadNum) reduction(+ : numVertices, numExpanded, numGrown)
+        for (int i = begin; i < end; ++i) {
+            GRNet& net = nets[netIndices[i]];
+            const utils::BoxT<int>& box = net.getBoundingBox();
+            for (int margin = parameters.maze_margin;; margin = std::max<int>(margin * parameters.maze_margin_growth, margin + 1)) {
+                utils::BoxT<int> area = die;
+                if (margin >= 0)
+                    area.Set(std::max(box.lx() - margin, 0), std::max(box.ly() - margin, 0),
+                             std::min(box.hx() + margin, die.hx()), std::min(box.hy() + margin, die.hy()));
+                const bool clipped = area != die;
+                SparseGrid grid(1, 1, 0, 0);
+                grid.seek(i);  // same grid lines as in the serial order
+                MazeRoute mazeRoute(net, gridGraph, parameters);
+                mazeRoute.constructSparsifiedGraph(wireCostView, grid, area);
+                numVertices += mazeRoute.getNumVertices();
+                const bool connected = mazeRoute.run(parameters.maze_astar);
+                numExpanded += mazeRoute.getNumExpanded();
+                if (!connected) {
+                    if (clipped) {
+                        numGrown++;
+                        continue;
+                    }
+                    std::cerr << "[ERROR] Maze routing failed to connect all pins of net " << net.getName() << std::endl;
+                    break;  // the net keeps its current route
+                }
+                const SteinerTree mazeTree(mazeRoute.getSteinerTree());
+                utils::BoxT<int> extent;
+                for (int k = 0; k < mazeTree.size(); ++k) extent.Update(mazeTree[k]);
+                if (clipped && ((extent.lx() < box.lx() && extent.lx() == area.lx() && area.lx() > 0) ||
+                                (extent.ly() < box.ly() && extent.ly() == area.ly() && area.ly() > 0) ||
+                                (extent.hx() > box.hx() && extent.hx() == area.hx() && area.hx() < die.hx()) ||
+                                (extent.hy() > box.hy() && extent.hy() == area.hy() && area.hy() < die.hy()))) {
+                    numGrown++;
+                    continue;
+                }
+                mazeTrees[i] = mazeTree;
+                extents[i] = extent;
+                break;
+            }
+        }
 
-    for (int netIndex : netIndices) {
-        MazeRoute mazeRoute(nets[netIndex], gridGraph, parameters);
-        mazeRoute.constructSparsifiedGraph(wireCostView, grid);
-        mazeRoute.run();
-        gridGraph.commitTree(nets[netIndex].getRoutingTree());
-        gridGraph.updateWireCostView(wireCostView, nets[netIndex].getRoutingTree());
-        grid.step();
+        // 2. Pattern routing assigns the layers against the current demand and commits the nets in order. A net keeps its
+        // route from the earlier stages where that is cheaper at the same demand, so the stage does not add overflow
+        // that pattern routing had avoided.
+        const std::vector<int> batch(netIndices.begin() + begin, netIndices.begin() + end);
+        const std::vector<utils::BoxT<int>> batchExtents(extents.begin() + begin, extents.begin() + end);
+        previousTrees.resize(end - begin);
+        for (int i = begin; i < end; ++i) previousTrees[i - begin] = nets[netIndices[i]].getRoutingTree();
+        scheduleNets(batch, threadNum, true, [&](int netIndex) {
+            const SteinerTree& mazeTree = mazeTrees[treeIndex[netIndex]];
+            if (mazeTree.empty())
+                return;
+            GRNet& net = nets[netIndex];
+            GRTree previousTree = net.getRoutingTree();
+            PatternRoute patternRoute(net, gridGraph, parameters);
+            patternRoute.setSteinerTree(mazeTree);
+            patternRoute.constructRoutingDAG();
+            patternRoute.run();
+            if (gridGraph.getTreeCost(previousTree) <= gridGraph.getTreeCost(net.getRoutingTree()))
+                net.setRoutingTree(std::move(previousTree));
+            else
+                numImproved++;
+        }, nullptr, &batchExtents);
+        if (end == netSize)
+            break;
+        // Demand changed only where the batch removed or added wires and vias
+        for (int i = begin; i < end; ++i) {
+            gridGraph.updateWireCostView(wireCostView, previousTrees[i - begin]);
+            gridGraph.updateWireCostView(wireCostView, nets[netIndices[i]].getRoutingTree());
+        }
     }
+    std::cout << "[INFO] Maze routing" << (parameters.maze_astar ? " (A*)" : "") << ": " << netSize << " nets in "
+              << (netSize + batchSize - 1) / batchSize << " batches, " << numVertices / std::max(netSize, 1)
+              << " vertices and " << numExpanded / std::max(netSize, 1) << " expanded per net on average";
+    if (numGrown > 0)
+        std::cout << ", " << numGrown << " graphs grown";
+    std::cout << "; " << numImproved << " routes replaced" << std::endl;
 }
 
 void GlobalRouter::write() {
@@ -216,48 +311,86 @@ void GlobalRouter::write() {
 }
 
 // Helper functions
-void GlobalRouter::separateNetIndices(std::vector<int>& netIndices, std::vector<std::vector<int>>& nonoverlapNetIndices) const {
-    const int numGroups = nonoverlapNetIndices.size() - 1; // Last group is reserved for the rest
-    if (numGroups <= 0) {
-        std::cerr << "[ERROR] Number of groups must be greater than 0." << std::endl;
-        return;
-    }
-
+void GlobalRouter::scheduleNets(const std::vector<int>& netIndices, int threadNum, bool detours, const std::function<void(int)>& routeNet,
+                                GridGraphView<bool>* congestionView, const std::vector<utils::BoxT<int>>* extents) {
+    // Area a net may touch: its bounding box, plus the farthest detour shift in stage 2 (see PatternRoute::constructDetours),
+    // plus the extent of its new route if given. Vias also change the demand of the edge below their gcell, so the area
+    // starts one gcell lower.
     const int netSize = netIndices.size();
-    std::vector<int> netCenterX(netSize);
-    std::vector<int> divideX(numGroups - 1);
-
+    std::vector<utils::BoxT<int>> areas(netSize);
     for (int i = 0; i < netSize; ++i) {
-        const GRNet& net = nets[netIndices[i]];
-        netCenterX[i] = net.getBoundingBox().cx();
-    }
-
-    std::sort(netCenterX.begin(), netCenterX.end());
-
-    for (int i = 0; i < numGroups - 1; ++i) {
-        divideX[i] = netCenterX[(i + 1) * netSize / numGroups];
+        const utils::BoxT<int>& box = nets[netIndices[i]].getBoundingBox();
+        const int margin = detours ? std::ceil(parameters.max_detour_ratio * std::max(box.x.range(), box.y.range())) + 1 : 0;
+        areas[i].Set(std::max(box.lx() - margin - 1, 0), std::max(box.ly() - margin - 1, 0),
+                     std::min(box.hx() + margin, (int)gridGraph.getSize(0) - 1), std::min(box.hy() + margin, (int)gridGraph.getSize(1) - 1));
+        if (extents && (*extents)[i].IsValid()) {
+            const utils::BoxT<int>& extent = (*extents)[i];
+            areas[i] = areas[i].UnionWith({std::max(extent.lx() - 1, 0), std::max(extent.ly() - 1, 0), extent.hx(), extent.hy()});
+        }
     }
 
-    for (int i = 0; i < netSize; ++i) {
-        const GRNet& net = nets[netIndices[i]];
-        const auto& boundingBox = net.getBoundingBox();
-        const int xlow = boundingBox.x.low, xhigh = boundingBox.x.high;
-
-        bool assigned = false;
-        for (int j = 0; j < numGroups; ++j) {
-            if ((j == 0 && xhigh < divideX[j]) ||
-                (j == numGroups - 1 && xlow > divideX[j - 1]) ||
-                (j > 0 && xhigh < divideX[j] && xlow > divideX[j - 1])) {
-                nonoverlapNetIndices[j].push_back(netIndices[i]);
-                assigned = true;
-                break;
+    // Nets routed in an earlier stage (all of them in stage 2) are ripped up before routeNet and committed after it
+    auto ripUp = [&](int i) { gridGraph.commitTree(nets[netIndices[i]].getRoutingTree(), true, netIndices[i]); };
+    auto route = [&](int i) { routeNet(netIndices[i]); };
+    auto commit = [&](int i) { gridGraph.commitTree(nets[netIndices[i]].getRoutingTree(), false, netIndices[i]); };
+    const bool routed = netSize > 0 && !nets[netIndices[0]].getRoutingTree().empty();
+
+    NetScheduler scheduler(areas, gridGraph.getSize(0), gridGraph.getSize(1));
+    if (parameters.optimistic_routing) {
+        const int numRetries = scheduler.runOptimistic(threadNum, routed ? ripUp : std::function<void(int)>(), route, commit);
+        std::cout << "[INFO] Optimistic routing: " << netSize << " nets, " << numRetries << " routed again" << std::endl;
+    } else if (congestionView && parameters.batched_rerouting) {
+        // Nets of a batch do not touch each other's areas, so each one sees the state left by the earlier batches
+        std::vector<std::vector<int>> batches;
+        scheduler.getBatches(batches);
+        std::vector<GRTree> previousTrees;
+        size_t largest = 0;
+        for (const std::vector<int>& batch : batches) {
+            const int batchSize = batch.size();
+            largest = std::max(largest, batch.size());
+            previousTrees.resize(batchSize);
+#pragma omp parallel for schedule(dynamic, 1) num_threads(threadNum)
+            for (int k = 0; k < batchSize; ++k) {
+                previousTrees[k] = nets[netIndices[batch[k]]].getRoutingTree();
+                if (routed)
+                    ripUp(batch[k]);
+            }
+#pragma omp parallel for schedule(dynamic, 1) num_threads(threadNum)
+            for (int k = 0; k < batchSize; ++k) route(batch[k]);
+#pragma omp parallel for schedule(dynamic, 1) num_threads(threadNum)
+            for (int k = 0; k < batchSize; ++k) commit(batch[k]);
+            // Overflow changes only where the batch removed or added wires and vias
+            for (int k = 0; k < batchSize; ++k) {
+                gridGraph.updateCongestionView(*congestionView, previousTrees[k]);
+                gridGraph.updateCongestionView(*congestionView, nets[netIndices[batch[k]]].getRoutingTree());
             }
         }
+        std::cout << "[INFO] Batched rerouting: " << netSize << " nets in " << batches.size() << " batches (largest " << largest << ")" << std::endl;
+        scheduler.printWaves();
+    } else {
+        scheduler.run(threadNum, [&](int i) {
+            if (routed)
+                ripUp(i);
+            route(i);
+            commit(i);
+        });
+        std::cout << "[INFO] Conflict graph: " << netSize << " nets, " << scheduler.getNumEdges() << " dependencies, critical path "
+                  << scheduler.getCriticalPath() << " nets" << std::endl;
+        scheduler.printWaves();
+    }
+}
 
-        if (!assigned) {
-            nonoverlapNetIndices[numGroups].push_back(netIndices[i]); // Add to the "rest" group
-        }
+void GlobalRouter::collectOverflowingNets(int overflowThreshold, std::vector<int>& netIndices) {
+    // Only the committed routes over overflowed edges are looked at (see NetTileIndex)
+    std::vector<char> overflowing(nets.size(), false);
+    const int64_t numScanned = gridGraph.selectOverflowingNets(overflowThreshold, overflowing);
+    netIndices.clear();
+    for (size_t i = 0; i < nets.size(); ++i) {
+        if (overflowing[i])
+            netIndices.push_back(nets[i].getIndex());
     }
+    std::cout << "[INFO] Scanned " << numScanned << " route pieces over overflowed edges, " << netIndices.size() << " / "
+              << nets.size() << " nets overflowing" << std::endl;
 }
 
 void GlobalRouter::sortNetIndices(vector<int>& netIndices) const {  // sort by half perimeter: 短的先繞
@@ -286,22 +419,20 @@ void GlobalRouter::printStatistics() const {
     );
 
     for (const auto& net : nets) {
-        GRTreeNode::preorder(net.getRoutingTree(), [&](std::shared_ptr<GRTreeNode> node) {
-            for (const auto& child : node->children) {
-                if (node->layerIdx == child->layerIdx) {
-                    unsigned direction = gridGraph.getLayerDirection(node->layerIdx);
-                    int l = std::min((*node)[direction], (*child)[direction]);
-                    int h = std::max((*node)[direction], (*child)[direction]);
-                    int r = (*node)[1 - direction];
-                    for (int c = l; c < h; ++c) {
-                        wireLength += gridGraph.getEdgeLength(direction, c);
-                        int x = direction == 0 ? c : r;
-                        int y = direction == 0 ? r : c;
-                        wireUsage[node->layerIdx][x][y] += 1;
-                    }
-                } else {
-                    viaCount += std::abs(node->layerIdx - child->layerIdx);
+        net.getRoutingTree().forEachEdge([&](const GRTree::Node& node, const GRTree::Node& child) {
+            if (node.layerIdx == child.layerIdx) {
+                unsigned direction = gridGraph.getLayerDirection(node.layerIdx);
+                int l = std::min(node[direction], child[direction]);
+                int h = std::max(node[direction], child[direction]);
+                int r = node[1 - direction];
+                for (int c = l; c < h; ++c) {
+                    wireLength += gridGraph.getEdgeLength(direction, c);
+                    int x = direction == 0 ? c : r;
+                    int y = direction == 0 ? r : c;
+                    wireUsage[node.layerIdx][x][y] += 1;
                 }
+            } else {
+                viaCount += std::abs(node.layerIdx - child.layerIdx);
             }
         });
     }
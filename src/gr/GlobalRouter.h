@@ -1,8 +1,10 @@
 #pragma once
+#include <chrono>
 #include "../global.h"
 #include "../basic/design.h"
 #include "GridGraph.h"
 #include "GRNet.h"
+#include "PatternRoute.h"
 
 class GlobalRouter {
 public:
@@ -15,14 +17,28 @@ private:
     const Parameters& parameters;
     GridGraph gridGraph;
     std::vector<GRNet> nets;
+    std::vector<SteinerTree> steinerTrees;  // steinerTrees[netIndex], shared by stage 1 and stage 2
+    FluteCache fluteCache;
 
     // Routing
+    void constructSteinerTrees(const std::vector<int>& netIndices);  // selects access points and runs FLUTE for all nets in parallel
     void stagePatternRouting(std::vector<int>& netIndices, int threadNum, int& n1);
     void stagePatternRoutingWithDetours(std::vector<int>& netIndices, int threadNum, int& n2);
-    void stageMazeRouting(std::vector<int>& netIndices);
+    void stageNegotiatedRouting(int threadNum);  // rounds of rerouting the overflowing nets with growing history costs
+    void stageMazeRouting(std::vector<int>& netIndices, int threadNum);
+    // Rips up and reroutes nets with pattern routing and detours; returns the number of nets left as they were because
+    // the deadline passed
+    int rerouteWithDetours(std::vector<int>& netIndices, int threadNum, std::chrono::steady_clock::time_point deadline);
 
     // Helper functions
-    void separateNetIndices(std::vector<int>& netIndices, std::vector<std::vector<int>>& nonoverlapNetIndices) const;
+    // Routes all nets in parallel with routeNet and commits them. Unless parameters.optimistic_routing is set, the
+    // result is the same as routing them one after another in the order of netIndices (see NetScheduler). With
+    // parameters.batched_rerouting, congestionView (if given) is kept up to date between batches of independent nets.
+    // extents[i], if given, bounds the new route of netIndices[i] where it may leave the area of the net.
+    void scheduleNets(const std::vector<int>& netIndices, int threadNum, bool detours, const std::function<void(int)>& routeNet,
+                      GridGraphView<bool>* congestionView = nullptr, const std::vector<utils::BoxT<int>>* extents = nullptr);
+    // Nets whose routing tree has more than overflowThreshold overflow, from the overflowed edges of the grid graph
+    void collectOverflowingNets(int overflowThreshold, std::vector<int>& netIndices);
     void sortNetIndices(std::vector<int>& netIndices) const;
     
     // Analysis
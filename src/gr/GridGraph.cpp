@@ -36,15 +36,40 @@ GridGraph::GridGraph(const Design& design, const Parameters& params)
     UnitViaCost = design.metrics.UnitViaCost;
     OFWeight = design.metrics.OFWeight;
 
-    // initialize graphEdges using capacity
-    graphEdges.assign(nLayers, vector<vector<GraphEdge>>(xSize, vector<GraphEdge>(ySize)));
+    // initialize edge capacities, demands start at zero
+    const size_t numEdges = (size_t)xSize * ySize;
+    const size_t valuesPerLine = 64 / sizeof(CapacityT);
+    edgeStride = (numEdges + valuesPerLine - 1) / valuesPerLine * valuesPerLine;  // keep the demand array aligned
+    edgeData.resize(nLayers);
+    edgeDemands.resize(nLayers);
     for (unsigned l = 0; l < nLayers; l++) {
-        for (unsigned x = 0; x < xSize; x++) {
-            for (unsigned y = 0; y < ySize; y++) {
-                graphEdges[l][x][y].capacity = design.layers[l].capacity[y][x];  // Note capacity is stored in reverse order
+        edgeData[l].assign(2 * edgeStride, 0);
+        edgeDemands[l].reset(new std::atomic<CapacityT>[edgeStride]());
+        const vector<double>& capacity = design.layers[l].capacity;  // Note capacity is stored row by row
+        CapacityT* edgeCapacity = edgeData[l].data();
+        if (layerDirections[l] == 0) {
+            std::copy(capacity.begin(), capacity.begin() + numEdges, edgeCapacity);
+        } else {
+            for (unsigned x = 0; x < xSize; x++) {
+                for (unsigned y = 0; y < ySize; y++) {
+                    edgeCapacity[(size_t)x * ySize + y] = capacity[(size_t)y * xSize + x];
+                }
             }
         }
     }
+
+    overflowBits.resize(nLayers);
+    for (unsigned l = 0; l < nLayers; l++) {
+        overflowBits[l].reset(new std::atomic<uint64_t>[(edgeStride + 63) / 64]());
+        for (size_t index = 0; index < numEdges; index++) updateOverflowBit(l, index);
+    }
+
+    // The cache holds quantized costs, so exact runs sum every segment from the edges instead
+    if (parameters.wire_cost_cache && !parameters.exact_cost)
+        wireCostCache.init(*this);
+    if (parameters.via_cost_cache)
+        viaCostCache.init(*this);
+    netTileIndex.init(nLayers, xSize, ySize);
 }
 
 DBU GridGraph::getEdgeLength(unsigned direction, unsigned edgeIndex) const {
@@ -53,51 +78,109 @@ DBU GridGraph::getEdgeLength(unsigned direction, unsigned edgeIndex) const {
 
 inline double GridGraph::logistic(const CapacityT& input, bool s) const {
     double slope = s ? parameters.cost_logistic_slope1 : parameters.cost_logistic_slope2;
-    return exp(-input * slope);
+    return parameters.exact_cost ? exp(-input * slope) : fastExp(-input * slope);
 }
 
 CostT GridGraph::getWireCost(const int layerIndex, const utils::PointT<int> lower, const CapacityT demand) const {
     unsigned direction = layerDirections[layerIndex];
     DBU edgeLength = getEdgeLength(direction, lower[direction]);
     DBU demandLength = demand * edgeLength;
-    const auto& edge = graphEdges[layerIndex][lower.x][lower.y];
+    const GraphEdge edge = getEdge(layerIndex, lower.x, lower.y);
     CostT cost = demandLength * UnitLengthWireCost;
     bool s = edge.capacity < 0.0001;
     cost += 1 * logistic(edge.capacity - edge.demand, s) * OFWeight[layerIndex];
+    if (hasHistoryCosts)
+        cost += getHistories(layerIndex)[getEdgeIndex(layerIndex, lower.x, lower.y)];
     return cost;
 }
 
 CostT GridGraph::getWireCost(const int layerIndex, const utils::PointT<int> u, const utils::PointT<int> v) const {
+    if (!wireCostCache.isInitialized())
+        return sumWireCost(layerIndex, u, v);
     unsigned direction = layerDirections[layerIndex];
     assert(u[1 - direction] == v[1 - direction]);
-    CostT cost = 0;
-    if (direction == 0) {
-        int l = min(u.x, v.x), h = max(u.x, v.x);
-        // #pragma omp parallel for reduction(+:cost) // Apply OpenMP parallel for loop with reduction on cost
-        for (int x = l; x < h; x++)
-            cost += getWireCost(layerIndex, {x, u.y});
-    } else {
-        int l = min(u.y, v.y), h = max(u.y, v.y);
-        // #pragma omp parallel for reduction(+:cost) // Apply OpenMP parallel for loop with reduction on cost
-        for (int y = l; y < h; y++)
-            cost += getWireCost(layerIndex, {u.x, y});
+    const int l = min(u[direction], v[direction]), h = max(u[direction], v[direction]);
+    CostT cost;
+    if (!wireCostCache.query(layerIndex, u[1 - direction], l, h, cost))
+        return sumWireCost(layerIndex, u, v);  // a capped edge, the cached sum would understate the cost
+    if (parameters.validate_wire_cost_cache) {
+        CostT exact = sumWireCost(layerIndex, u, v);
+        if (!WireCostCache::matches(cost, exact, h - l)) {
+            std::cerr << "[ERROR] Cached wire cost " << cost << " differs from " << exact << " on layer " << layerIndex
+                      << " between " << u << " and " << v << std::endl;
+        }
     }
     return cost;
 }
 
+CostT GridGraph::sumWireCost(const int layerIndex, const utils::PointT<int> u, const utils::PointT<int> v) const {
+    unsigned direction = layerDirections[layerIndex];
+    assert(u[1 - direction] == v[1 - direction]);
+    const int l = min(u[direction], v[direction]), h = max(u[direction], v[direction]);
+    static thread_local vector<CostT> costs;
+    costs.resize(h - l);
+    getWireCosts(layerIndex, u[1 - direction], l, h, costs.data());
+    CostT cost = 0;
+    for (CostT edgeCost : costs)
+        cost += edgeCost;
+    return cost;
+}
+
+void GridGraph::getWireCosts(const int layerIndex, const int track, const int low, const int high, CostT* costs) const {
+    unsigned direction = layerDirections[layerIndex];
+    assert(0 <= low && low <= high && high < getSize(direction));
+    const size_t offset = (size_t)track * getSize(direction);
+    const vector<int>& edgeLengths = direction == 0 ? hEdge : vEdge;
+    const WireCostTerms terms = {UnitLengthWireCost, OFWeight[layerIndex], parameters.cost_logistic_slope1,
+                                 parameters.cost_logistic_slope2, parameters.exact_cost};
+    // The kernel reads plain arrays, so the demands of the segment are loaded once up front
+    static thread_local vector<CapacityT> demands;
+    demands.resize(high - low);
+    for (int i = low; i < high; i++) demands[i - low] = getDemand(layerIndex, offset + i);
+    computeWireCosts(getCapacities(layerIndex) + offset + low, demands.data(), edgeLengths.data() + low, high - low, terms, costs);
+    if (hasHistoryCosts) {
+        const CostT* histories = getHistories(layerIndex) + offset + low;
+        for (int i = 0; i < high - low; i++) costs[i] += histories[i];
+    }
+}
+
 CostT GridGraph::getViaCost(const int layerIndex, const utils::PointT<int> loc) const {
     assert(layerIndex + 1 < nLayers);
     CostT cost = UnitViaCost;
     for (int l = layerIndex; l <= layerIndex + 1; l++) {
         CapacityT demand = parameters.UnitViaDemand;
-        const auto& edge = graphEdges[l][loc.x][loc.y];
+        const GraphEdge edge = getEdge(l, loc.x, loc.y);
         bool s = edge.capacity < 0.0001;
         cost += demand * logistic(edge.capacity - edge.demand, s) * OFWeight[l];
     }
     return cost;
 }
 
-void GridGraph::selectAccessPoints(GRNet& net, robin_hood::unordered_map<uint64_t, std::pair<utils::PointT<int>, utils::IntervalT<int>>>& selectedAccessPoints) const {
+void GridGraph::getViaCosts(const utils::PointT<int> loc, CostT* viaCosts) const {
+    if (viaCostCache.isInitialized()) {
+        viaCostCache.query(*this, loc, viaCosts);
+        return;
+    }
+    viaCosts[0] = 0;
+    for (int layerIndex = 1; layerIndex < nLayers; layerIndex++)
+        viaCosts[layerIndex] = viaCosts[layerIndex - 1] + getViaCost(layerIndex - 1, loc);
+}
+
+CostT GridGraph::getTreeCost(const GRTree& tree) const {
+    CostT cost = 0;
+    tree.forEachEdge([&](const GRTree::Node& node, const GRTree::Node& child) {
+        if (node.layerIdx == child.layerIdx) {
+            cost += getWireCost(node.layerIdx, (utils::PointT<int>)node, (utils::PointT<int>)child);
+        } else {
+            const int maxLayerIndex = max(node.layerIdx, child.layerIdx);
+            for (int layerIndex = min(node.layerIdx, child.layerIdx); layerIndex < maxLayerIndex; layerIndex++)
+                cost += getViaCost(layerIndex, {node.x, node.y});
+        }
+    });
+    return cost;
+}
+
+void GridGraph::selectAccessPoints(const GRNet& net, robin_hood::unordered_map<uint64_t, std::pair<utils::PointT<int>, utils::IntervalT<int>>>& selectedAccessPoints) const {
     selectedAccessPoints.clear();
     // cell hash (2d) -> access point, fixed layer interval
     selectedAccessPoints.reserve(net.getNumPins());
@@ -144,21 +227,61 @@ void GridGraph::selectAccessPoints(GRNet& net, robin_hood::unordered_map<uint64_
     }
 }
 
+void GridGraph::updateOverflowBit(const int layerIndex, const size_t edgeIndex) {
+    const uint64_t bit = uint64_t(1) << (edgeIndex % 64);
+    std::atomic<uint64_t>& word = overflowBits[layerIndex][edgeIndex / 64];
+    const bool overflowed = getCapacities(layerIndex)[edgeIndex] - getDemand(layerIndex, edgeIndex) < 0.0;
+    if (overflowed != bool(word.load(std::memory_order_relaxed) & bit)) {
+        if (overflowed)
+            word.fetch_or(bit, std::memory_order_relaxed);
+        else
+            word.fetch_and(~bit, std::memory_order_relaxed);
+    }
+}
+
+CapacityT GridGraph::addDemand(const int layerIndex, const size_t edgeIndex, const CapacityT delta) {
+    std::atomic<CapacityT>& demand = edgeDemands[layerIndex][edgeIndex];
+    CapacityT current = demand.load(std::memory_order_relaxed);
+    while (!demand.compare_exchange_weak(current, current + delta, std::memory_order_relaxed)) {}
+    return current + delta;
+}
+
 void GridGraph::commit(const int layerIndex, const utils::PointT<int> lower, const CapacityT demand) {
-    graphEdges[layerIndex][lower.x][lower.y].demand += demand;
-    assert(graphEdges[layerIndex][lower.x][lower.y].demand > -1);
+    const size_t edgeIndex = getEdgeIndex(layerIndex, lower.x, lower.y);
+    const CapacityT edgeDemand = demand != 0 ? addDemand(layerIndex, edgeIndex, demand) : getDemand(layerIndex, edgeIndex);
+    assert(edgeDemand > -1);
+    if (demand != 0)
+        updateOverflowBit(layerIndex, edgeIndex);
+    if (demand != 0 && viaCostCache.isInitialized())
+        viaCostCache.invalidate(lower.x, lower.y);
+    if (demand != 0 && wireCostCache.isInitialized()) {
+        unsigned direction = layerDirections[layerIndex];
+        wireCostCache.update(*this, layerIndex, lower[1 - direction], lower[direction], lower[direction] + 1);
+    }
 }
 
-void GridGraph::commitWire(const int layerIndex, const utils::PointT<int> lower, const bool reverse) {
+void GridGraph::commitWire(const int layerIndex, const utils::PointT<int> u, const utils::PointT<int> v, const bool reverse) {
     unsigned direction = layerDirections[layerIndex];
-    DBU edgeLength = getEdgeLength(direction, lower[direction]);
-    if (reverse) {
-        commit(layerIndex, lower, -1);
-        totalLength -= edgeLength;
-    } else {
-        commit(layerIndex, lower, 1);
-        totalLength += edgeLength;
+    assert(u[1 - direction] == v[1 - direction]);
+    const int l = min(u[direction], v[direction]), h = max(u[direction], v[direction]);
+    const size_t offset = getEdgeIndex(layerIndex, u.x, u.y) - u[direction];
+    const vector<int>& edgeLengths = direction == 0 ? hEdge : vEdge;
+    const CapacityT delta = reverse ? -1 : 1;
+    DBU length = 0;
+    utils::PointT<int> lower = u;
+    for (int i = l; i < h; i++) {
+        const CapacityT demand = addDemand(layerIndex, offset + i, delta);
+        assert(demand > -1);
+        updateOverflowBit(layerIndex, offset + i);
+        length += edgeLengths[i];
+        if (viaCostCache.isInitialized()) {
+            lower[direction] = i;
+            viaCostCache.invalidate(lower.x, lower.y);
+        }
     }
+    totalLength += reverse ? -length : length;
+    if (wireCostCache.isInitialized())
+        wireCostCache.update(*this, layerIndex, u[1 - direction], l, h);
 }
 
 void GridGraph::commitVia(const int layerIndex, const utils::PointT<int> loc, const bool reverse, bool isStackedVia) {
@@ -183,44 +306,54 @@ void GridGraph::commitVia(const int layerIndex, const utils::PointT<int> loc, co
     assert(totalNumVias >= 0);
 }
 
-void GridGraph::commitTree(const std::shared_ptr<GRTreeNode>& tree, const bool reverse) {
-    GRTreeNode::preorder(tree, [&](std::shared_ptr<GRTreeNode> node) {
-        for (const auto& child : node->children) {
-            if (node->layerIdx == child->layerIdx) {
-                unsigned direction = layerDirections[node->layerIdx];
-                if (direction == 0) {
-                    assert(node->y == child->y);
-                    int l = min(node->x, child->x), h = max(node->x, child->x);
-                    for (int x = l; x < h; x++) {
-                        commitWire(node->layerIdx, {x, node->y}, reverse);
-                    }
-                } else {
-                    assert(node->x == child->x);
-                    int l = min(node->y, child->y), h = max(node->y, child->y);
-                    for (int y = l; y < h; y++) {
-                        commitWire(node->layerIdx, {node->x, y}, reverse);
-                    }
-                }
-            } else {
-                int maxLayerIndex = max(node->layerIdx, child->layerIdx);
-                int minLayerIndex = min(node->layerIdx, child->layerIdx);
-                for (int layerIdx = minLayerIndex; layerIdx < maxLayerIndex; layerIdx++) {
-                    if (layerIdx == minLayerIndex || layerIdx == maxLayerIndex - 1)
-                        commitVia(layerIdx, {node->x, node->y}, reverse, false);
-                    else
-                        commitVia(layerIdx, {node->x, node->y}, reverse, true);
-                }
-                // for (int layerIdx = min(node->layerIdx, child->layerIdx); layerIdx < maxLayerIndex; layerIdx++) {
-                //     if (layerIdx == min(node->layerIdx, child->layerIdx) || layerIdx == maxLayerIndex - 1)
-                //         commitVia(layerIdx, {node->x, node->y}, reverse, false);
-                //     else
-                //         commitVia(layerIdx, {node->x, node->y}, reverse, true);
-                // }
+void GridGraph::commitTree(const GRTree& tree, const bool reverse, const int netIndex) {
+    if (netIndex >= 0)
+        netTileIndex.update(tree, netIndex, reverse, layerDirections);
+    tree.forEachEdge([&](const GRTree::Node& node, const GRTree::Node& child) {
+        if (node.layerIdx == child.layerIdx) {
+            commitWire(node.layerIdx, (utils::PointT<int>)node, (utils::PointT<int>)child, reverse);
+        } else {
+            int maxLayerIndex = max(node.layerIdx, child.layerIdx);
+            int minLayerIndex = min(node.layerIdx, child.layerIdx);
+            for (int layerIdx = minLayerIndex; layerIdx < maxLayerIndex; layerIdx++) {
+                if (layerIdx == minLayerIndex || layerIdx == maxLayerIndex - 1)
+                    commitVia(layerIdx, {node.x, node.y}, reverse, false);
+                else
+                    commitVia(layerIdx, {node.x, node.y}, reverse, true);
             }
+            // for (int layerIdx = min(node.layerIdx, child.layerIdx); layerIdx < maxLayerIndex; layerIdx++) {
+            //     if (layerIdx == min(node.layerIdx, child.layerIdx) || layerIdx == maxLayerIndex - 1)
+            //         commitVia(layerIdx, {node.x, node.y}, reverse, false);
+            //     else
+            //         commitVia(layerIdx, {node.x, node.y}, reverse, true);
+            // }
         }
     });
 }
 
+CapacityT GridGraph::addHistoryCosts(const CostT step) {
+    CapacityT overflow = 0;
+    forEachOverflowedEdge([&](int layerIndex, int x, int y) {
+        const size_t edgeIndex = getEdgeIndex(layerIndex, x, y);
+        const CapacityT edgeOverflow = getDemand(layerIndex, edgeIndex) - getCapacities(layerIndex)[edgeIndex];
+        getHistories(layerIndex)[edgeIndex] += step * OFWeight[layerIndex] * edgeOverflow;
+        overflow += edgeOverflow;
+    });
+    hasHistoryCosts = true;
+    if (wireCostCache.isInitialized())
+        wireCostCache.init(*this);  // cheaper than one suffix update per changed edge
+    return overflow;
+}
+
+CapacityT GridGraph::getTotalOverflow() const {
+    CapacityT overflow = 0;
+    forEachOverflowedEdge([&](int layerIndex, int x, int y) {
+        const size_t edgeIndex = getEdgeIndex(layerIndex, x, y);
+        overflow += getDemand(layerIndex, edgeIndex) - getCapacities(layerIndex)[edgeIndex];
+    });
+    return overflow;
+}
+
 bool GridGraph::checkOverflow_stage(const int layerIndex, const int x, const int y, int overflowThreshold) const {
         return getEdge(layerIndex, x, y).getResource() < -overflowThreshold;
 }
@@ -228,73 +361,70 @@ bool GridGraph::checkOverflow_stage(const int layerIndex, const int x, const int
 int GridGraph::checkOverflow(const int layerIndex, const utils::PointT<int> u, const utils::PointT<int> v, int overflowThreshold) const {
     int num = 0;
     unsigned direction = layerDirections[layerIndex];
-    if (direction == 0) {
-        assert(u.y == v.y);
-        int l = min(u.x, v.x), h = max(u.x, v.x);
-        for (int x = l; x < h; x++) {
-            if (checkOverflow_stage(layerIndex, x, u.y, overflowThreshold))
-                num++;
-        }
-    } else {
-        assert(u.x == v.x);
-        int l = min(u.y, v.y), h = max(u.y, v.y);
-        for (int y = l; y < h; y++) {
-            if (checkOverflow_stage(layerIndex, u.x, y, overflowThreshold))
-                num++;
-        }
+    assert(u[1 - direction] == v[1 - direction]);
+    const int l = min(u[direction], v[direction]), h = max(u[direction], v[direction]);
+    const size_t offset = getEdgeIndex(layerIndex, u.x, u.y) - u[direction];
+    const CapacityT* capacity = getCapacities(layerIndex) + offset;
+    for (int i = l; i < h; i++) {
+        num += (capacity[i] - getDemand(layerIndex, offset + i)) < -overflowThreshold;
     }
     return num;
 }
 
-int GridGraph::checkOverflow(const std::shared_ptr<GRTreeNode>& tree, int overflowThreshold) const {
-    if (!tree)
+int GridGraph::checkOverflow(const GRTree& tree, int overflowThreshold) const {
+    if (tree.empty())
         return 0;
     int num = 0;
-    GRTreeNode::preorder(tree, [&](std::shared_ptr<GRTreeNode> node) {
-        for (auto& child : node->children) {
-            if (node->layerIdx == child->layerIdx) {
-                num += checkOverflow(node->layerIdx, (utils::PointT<int>)*node, (utils::PointT<int>)*child, overflowThreshold);
-            }
-            else {
-                assert(node->x == child->x && node->y == child->y);
-                int maxLayerIndex = max(node->layerIdx, child->layerIdx);
-                int minLayerIndex = min(node->layerIdx, child->layerIdx);
-                for (int layerIdx = minLayerIndex + 1; layerIdx < maxLayerIndex; layerIdx++) { // only check the middle layers (stacked vias)
-                    num += checkOverflow_stage(layerIdx, node->x, node->y, overflowThreshold); 
-                }
+    tree.forEachEdge([&](const GRTree::Node& node, const GRTree::Node& child) {
+        if (node.layerIdx == child.layerIdx) {
+            num += checkOverflow(node.layerIdx, (utils::PointT<int>)node, (utils::PointT<int>)child, overflowThreshold);
+        }
+        else {
+            assert(node.x == child.x && node.y == child.y);
+            int maxLayerIndex = max(node.layerIdx, child.layerIdx);
+            int minLayerIndex = min(node.layerIdx, child.layerIdx);
+            for (int layerIdx = minLayerIndex + 1; layerIdx < maxLayerIndex; layerIdx++) { // only check the middle layers (stacked vias)
+                num += checkOverflow_stage(layerIdx, node.x, node.y, overflowThreshold); 
             }
         }
     });
     return num;
 }
 
-std::string GridGraph::getPythonString(const std::shared_ptr<GRTreeNode>& routingTree) const {
+int64_t GridGraph::selectOverflowingNets(const int overflowThreshold, vector<char>& selected) const {
+    vector<uint64_t> masks((size_t)netTileIndex.getNumTiles() * nLayers, 0);
+    forEachOverflowedEdge([&](int layerIndex, int x, int y) {
+        if (checkOverflow_stage(layerIndex, x, y, overflowThreshold))
+            masks[netTileIndex.getTileIndex(x, y) * nLayers + layerIndex] |= NetTileIndex::getEdgeBit(x, y);
+    });
+    return netTileIndex.selectNets(masks, selected);
+}
+
+std::string GridGraph::getPythonString(const GRTree& routingTree) const {
     vector<std::tuple<utils::PointT<int>, utils::PointT<int>, bool>> edges;
-    GRTreeNode::preorder(routingTree, [&](std::shared_ptr<GRTreeNode> node) {
-        for (auto& child : node->children) {
-            if (node->layerIdx == child->layerIdx) {
-                unsigned direction = getLayerDirection(node->layerIdx);
-                int r = (*node)[1 - direction];
-                const int l = min((*node)[direction], (*child)[direction]);
-                const int h = max((*node)[direction], (*child)[direction]);
-                if (l == h)
-                    continue;
-                utils::PointT<int> lpoint = (direction == 0 ? utils::PointT<int>(l, r) : utils::PointT<int>(r, l));
-                utils::PointT<int> hpoint = (direction == 0 ? utils::PointT<int>(h, r) : utils::PointT<int>(r, h));
-                bool congested = false;
-                for (int c = l; c < h; c++) {
-                    utils::PointT<int> cpoint = (direction == 0 ? utils::PointT<int>(c, r) : utils::PointT<int>(r, c));
-                    if (checkOverflow(node->layerIdx, cpoint.x, cpoint.y) != congested) {
-                        if (lpoint != cpoint) {
-                            edges.emplace_back(lpoint, cpoint, congested);
-                            lpoint = cpoint;
-                        }
-                        congested = !congested;
+    routingTree.forEachEdge([&](const GRTree::Node& node, const GRTree::Node& child) {
+        if (node.layerIdx == child.layerIdx) {
+            unsigned direction = getLayerDirection(node.layerIdx);
+            int r = node[1 - direction];
+            const int l = min(node[direction], child[direction]);
+            const int h = max(node[direction], child[direction]);
+            if (l == h)
+                return;
+            utils::PointT<int> lpoint = (direction == 0 ? utils::PointT<int>(l, r) : utils::PointT<int>(r, l));
+            utils::PointT<int> hpoint = (direction == 0 ? utils::PointT<int>(h, r) : utils::PointT<int>(r, h));
+            bool congested = false;
+            for (int c = l; c < h; c++) {
+                utils::PointT<int> cpoint = (direction == 0 ? utils::PointT<int>(c, r) : utils::PointT<int>(r, c));
+                if (checkOverflow(node.layerIdx, cpoint.x, cpoint.y) != congested) {
+                    if (lpoint != cpoint) {
+                        edges.emplace_back(lpoint, cpoint, congested);
+                        lpoint = cpoint;
                     }
+                    congested = !congested;
                 }
-                if (lpoint != hpoint)
-                    edges.emplace_back(lpoint, hpoint, congested);
             }
+            if (lpoint != hpoint)
+                edges.emplace_back(lpoint, hpoint, congested);
         }
     });
     std::stringstream ss;
@@ -321,118 +451,99 @@ void GridGraph::extractCongestionView(GridGraphView<bool>& view) const {
     }
 }
 
-void GridGraph::updateCongestionView(GridGraphView<bool>& view, std::shared_ptr<GRTreeNode> routingTree) const {
-    GRTreeNode::preorder(routingTree, [&](std::shared_ptr<GRTreeNode> node) {
-        for (const auto& child : node->children) {
-            if (node->layerIdx == child->layerIdx) {
-                unsigned direction = getLayerDirection(node->layerIdx);
-                if (direction == 0) {
-                    assert(node->y == child->y);
-                    int l = min(node->x, child->x), h = max(node->x, child->x);
-                    for (int x = l; x < h; x++) {
-                        view[direction][x][node->y] = checkOverflow(node->layerIdx, x, node->y);
-                    }
-                } else {
-                    assert(node->x == child->x);
-                    int l = min(node->y, child->y), h = max(node->y, child->y);
-                    for (int y = l; y < h; y++) {
-                        view[direction][node->x][y] = checkOverflow(node->layerIdx, node->x, y);
-                    }
+void GridGraph::updateCongestionView(GridGraphView<bool>& view, const GRTree& routingTree) const {
+    // Same as extractCongestionView: an edge is congested if it overflows on any layer of its direction
+    auto update = [&](unsigned direction, int x, int y) {
+        bool congested = false;
+        for (int layerIndex = parameters.min_routing_layer; !congested && layerIndex < nLayers; layerIndex++) {
+            congested = getLayerDirection(layerIndex) == direction && checkOverflow(layerIndex, x, y);
+        }
+        view[direction][x][y] = congested;
+    };
+    routingTree.forEachEdge([&](const GRTree::Node& node, const GRTree::Node& child) {
+        if (node.layerIdx == child.layerIdx) {
+            unsigned direction = getLayerDirection(node.layerIdx);
+            if (direction == 0) {
+                assert(node.y == child.y);
+                int l = min(node.x, child.x), h = max(node.x, child.x);
+                for (int x = l; x < h; x++) {
+                    update(direction, x, node.y);
                 }
             } else {
-                int maxLayerIndex = max(node->layerIdx, child->layerIdx);
-                for (int layerIdx = min(node->layerIdx, child->layerIdx); layerIdx < maxLayerIndex; layerIdx++) {
-                    unsigned direction = getLayerDirection(layerIdx);
-                    view[direction][node->x][node->y] = checkOverflow(layerIdx, node->x, node->y);
-                    if ((*node)[direction] > 0)
-                        view[direction][node->x - 1 + direction][node->y - direction] = checkOverflow(layerIdx, node->x - 1 + direction, node->y - direction);
+                assert(node.x == child.x);
+                int l = min(node.y, child.y), h = max(node.y, child.y);
+                for (int y = l; y < h; y++) {
+                    update(direction, node.x, y);
                 }
             }
+        } else {
+            int maxLayerIndex = max(node.layerIdx, child.layerIdx);
+            for (int layerIdx = min(node.layerIdx, child.layerIdx); layerIdx < maxLayerIndex; layerIdx++) {
+                unsigned direction = getLayerDirection(layerIdx);
+                update(direction, node.x, node.y);
+                if (node[direction] > 0)
+                    update(direction, node.x - 1 + direction, node.y - direction);
+            }
         }
     });
 }
 
+CostT GridGraph::getWireCostViewEntry(const unsigned direction, const int x, const int y) const {
+    // One more wire on the cheapest layer of the direction: length, congestion and history, as in pattern routing
+    CostT cost = std::numeric_limits<CostT>::max();
+    for (int layerIndex = parameters.min_routing_layer; layerIndex < getNumLayers(); layerIndex++) {
+        if (getLayerDirection(layerIndex) == direction)
+            cost = min(cost, getWireCost(layerIndex, {x, y}));
+    }
+    return cost;
+}
+
 void GridGraph::extractWireCostView(GridGraphView<CostT>& view) const {
     view.assign(2, vector<vector<CostT>>(xSize, vector<CostT>(ySize, std::numeric_limits<CostT>::max())));
     for (unsigned direction = 0; direction < 2; direction++) {
-        vector<int> layerIndices;
-        for (int layerIndex = parameters.min_routing_layer; layerIndex < getNumLayers(); layerIndex++) {
-            if (getLayerDirection(layerIndex) == direction) {
-                layerIndices.emplace_back(layerIndex);
-            }
-        }
-        for (int x = 0; x < xSize; x++) {
-            for (int y = 0; y < ySize; y++) {
+#pragma omp parallel for
+        for (int x = 0; x < (int)xSize; x++) {
+            for (int y = 0; y < (int)ySize; y++) {
                 int edgeIndex = direction == 0 ? x : y;
                 if (edgeIndex >= getSize(direction) - 1)
                     continue;
-                CapacityT capacity = 0;
-                CapacityT demand = 0;
-                for (int layerIndex : layerIndices) {
-                    const auto& edge = getEdge(layerIndex, x, y);
-                    capacity += edge.capacity;
-                    demand += edge.demand;
-                    assert(capacity >= 0);
-                    assert(demand > -1);
-                }
-                DBU length = getEdgeLength(direction, edgeIndex);
-                view[direction][x][y] = length * UnitLengthWireCost;
+                view[direction][x][y] = getWireCostViewEntry(direction, x, y);
             }
         }
     }
 }
 
-void GridGraph::updateWireCostView(GridGraphView<CostT>& view, std::shared_ptr<GRTreeNode> routingTree) const {
-    vector<vector<int>> sameDirectionLayers(2);
-    for (int layerIndex = parameters.min_routing_layer; layerIndex < getNumLayers(); layerIndex++) {
-        unsigned direction = getLayerDirection(layerIndex);
-        sameDirectionLayers[direction].emplace_back(layerIndex);
-    }
+void GridGraph::updateWireCostView(GridGraphView<CostT>& view, const GRTree& routingTree) const {
     auto update = [&](unsigned direction, int x, int y) {
         int edgeIndex = direction == 0 ? x : y;
         if (edgeIndex >= getSize(direction) - 1)
             return;
-        CapacityT capacity = 0;
-        CapacityT demand = 0;
-        for (int layerIndex : sameDirectionLayers[direction]) {
-            if (getLayerDirection(layerIndex) != direction)
-                continue;
-            const auto& edge = getEdge(layerIndex, x, y);
-            capacity += edge.capacity;
-            demand += edge.demand;
-            assert(capacity >= 0);
-            assert(demand > -1);
-        }
-        DBU length = getEdgeLength(direction, edgeIndex);
-
-        view[direction][x][y] = length * UnitLengthWireCost;
+        view[direction][x][y] = getWireCostViewEntry(direction, x, y);
     };
-    GRTreeNode::preorder(routingTree, [&](std::shared_ptr<GRTreeNode> node) {
-        for (const auto& child : node->children) {
-            if (node->layerIdx == child->layerIdx) {
-                unsigned direction = getLayerDirection(node->layerIdx);
-                if (direction == 0) {
-                    assert(node->y == child->y);
-                    int l = min(node->x, child->x), h = max(node->x, child->x);
-                    for (int x = l; x < h; x++) {
-                        update(direction, x, node->y);
-                    }
-                } else {
-                    assert(node->x == child->x);
-                    int l = min(node->y, child->y), h = max(node->y, child->y);
-                    for (int y = l; y < h; y++) {
-                        update(direction, node->x, y);
-                    }
+    routingTree.forEachEdge([&](const GRTree::Node& node, const GRTree::Node& child) {
+        if (node.layerIdx == child.layerIdx) {
+            unsigned direction = getLayerDirection(node.layerIdx);
+            if (direction == 0) {
+                assert(node.y == child.y);
+                int l = min(node.x, child.x), h = max(node.x, child.x);
+                for (int x = l; x < h; x++) {
+                    update(direction, x, node.y);
                 }
             } else {
-                int maxLayerIndex = max(node->layerIdx, child->layerIdx);
-                for (int layerIdx = min(node->layerIdx, child->layerIdx); layerIdx < maxLayerIndex; layerIdx++) {
-                    unsigned direction = getLayerDirection(layerIdx);
-                    update(direction, node->x, node->y);
-                    if ((*node)[direction] > 0)
-                        update(direction, node->x - 1 + direction, node->y - direction);
+                assert(node.x == child.x);
+                int l = min(node.y, child.y), h = max(node.y, child.y);
+                for (int y = l; y < h; y++) {
+                    update(direction, node.x, y);
                 }
             }
+        } else {
+            int maxLayerIndex = max(node.layerIdx, child.layerIdx);
+            for (int layerIdx = min(node.layerIdx, child.layerIdx); layerIdx < maxLayerIndex; layerIdx++) {
+                unsigned direction = getLayerDirection(layerIdx);
+                update(direction, node.x, node.y);
+                if (node[direction] > 0)
+                    update(direction, node.x - 1 + direction, node.y - direction);
+            }
         }
     });
 }
@@ -447,8 +558,7 @@ void GridGraph::writeHeatmap(const std::string heatmap_file) const {
         ss << layerIndex << std::endl;
         for (int y = 0; y < ySize; y++) {
             for (int x = 0; x < xSize; x++) {
-                ss << (graphEdges[layerIndex][x][y].capacity - graphEdges[layerIndex][x][y].demand)
-                     << (x == xSize - 1 ? "" : " ");
+                ss << getEdge(layerIndex, x, y).getResource() << (x == xSize - 1 ? "" : " ");
             }
             ss << std::endl;
         }
@@ -468,7 +578,7 @@ void GridGraph::writeCapacity(const std::string heatmap_file) const {
         ss << layerIndex << std::endl;
         for (int y = 0; y < ySize; y++) {
             for (int x = 0; x < xSize; x++) {
-                ss << graphEdges[layerIndex][x][y].capacity << (x == xSize - 1 ? "" : " ");
+                ss << getEdge(layerIndex, x, y).capacity << (x == xSize - 1 ? "" : " ");
             }
             ss << std::endl;
         }
@@ -2,12 +2,18 @@
 #include "../global.h"
 #include "../basic/design.h"
 #include "GRTree.h"
+#include "../utils/aligned.h"
+#include "WireCostCache.h"
+#include "ViaCostCache.h"
+#include "NetTileIndex.h"
+#include "WireCostKernel.h"
 
 class GRNet;
 template <typename Type> class GridGraphView;
 
 struct GraphEdge {
     GraphEdge(): capacity(0), demand(0) {}
+    GraphEdge(CapacityT capacity, CapacityT demand): capacity(capacity), demand(demand) {}
 
     CapacityT capacity;
     CapacityT demand;
@@ -29,32 +35,62 @@ public:
     // inline DBU getGridline(const unsigned dimension, const int index) const { return gridlines[dimension][index]; }
     // utils::BoxT<DBU> getCellBox(utils::PointT<int> point) const;
     // utils::BoxT<int> rangeSearchCells(const utils::BoxT<DBU>& box) const;
-    inline GraphEdge getEdge(const int layerIndex, const int x, const int y) const {return graphEdges[layerIndex][x][y]; }
+    inline GraphEdge getEdge(const int layerIndex, const int x, const int y) const {
+        const size_t index = getEdgeIndex(layerIndex, x, y);
+        return GraphEdge(getCapacities(layerIndex)[index], getDemand(layerIndex, index));
+    }
+    // Edges of a layer are stored track by track along its routing direction, so the edges of a wire are contiguous.
+    // The edge at (x, y) is edge x (horizontal) or y (vertical) of track y (horizontal) or x (vertical)
+    inline size_t getEdgeIndex(const int layerIndex, const int x, const int y) const {
+        return layerDirections[layerIndex] == 0 ? (size_t)y * xSize + x : (size_t)x * ySize + y;
+    }
+    inline const CapacityT* getCapacities(const int layerIndex) const { return edgeData[layerIndex].data(); }
+    inline CapacityT getDemand(const int layerIndex, const size_t edgeIndex) const {
+        return edgeDemands[layerIndex][edgeIndex].load(std::memory_order_relaxed);
+    }
+    inline const CostT* getHistories(const int layerIndex) const { return edgeData[layerIndex].data() + edgeStride; }
 
     // Costs
     DBU getEdgeLength(unsigned direction, unsigned edgeIndex) const;
     CostT getWireCost(const int layerIndex, const utils::PointT<int> u, const utils::PointT<int> v) const;
     CostT getViaCost(const int layerIndex, const utils::PointT<int> loc) const;
+    // viaCosts[l]: total getViaCost from layer 0 up to layer l at loc
+    void getViaCosts(const utils::PointT<int> loc, CostT* viaCosts) const;
     inline CostT getUnitViaCost() const { return UnitViaCost; }
+    // Wire and via costs of routing the tree at the current demand, as if it was not committed
+    CostT getTreeCost(const GRTree& tree) const;
     
     // Misc
-    void selectAccessPoints(GRNet& net, robin_hood::unordered_map<uint64_t, std::pair<utils::PointT<int>, utils::IntervalT<int>>>& selectedAccessPoints) const;
+    void selectAccessPoints(const GRNet& net, robin_hood::unordered_map<uint64_t, std::pair<utils::PointT<int>, utils::IntervalT<int>>>& selectedAccessPoints) const;
     
     // Methods for updating demands 
-    void commitTree(const std::shared_ptr<GRTreeNode>& tree, const bool reverse = false);
+    // With netIndex >= 0, the tree is also added to (or with reverse, removed from) netTileIndex
+    void commitTree(const GRTree& tree, const bool reverse = false, const int netIndex = -1);
+    // Negotiated congestion: adds step * OFWeight * overflow to the history cost of every overflowed edge. History
+    // costs are part of every wire cost from then on. Returns the total overflow (demand - capacity) of those edges
+    CapacityT addHistoryCosts(const CostT step);
+    CapacityT getTotalOverflow() const;
     
     // Checks
     inline bool checkOverflow(const int layerIndex, const int x, const int y) const { return getEdge(layerIndex, x, y).getResource() < 0.0; }
     bool checkOverflow_stage(const int layerIndex, const int x, const int y, const int overflowThreshold) const;
     int checkOverflow(const int layerIndex, const utils::PointT<int> u, const utils::PointT<int> v, int overflowThreshold) const; // Check wire overflow
-    int checkOverflow(const std::shared_ptr<GRTreeNode>& tree, int overflowThreshold) const; // Check routing tree overflow (Only wires are checked)
-    std::string getPythonString(const std::shared_ptr<GRTreeNode>& routingTree) const;
+    int checkOverflow(const GRTree& tree, int overflowThreshold) const; // Check routing tree overflow (Only wires are checked)
+    std::string getPythonString(const GRTree& routingTree) const;
+    // Calls visit(layerIndex, x, y) for every edge with a negative resource, in time proportional to the number of
+    // edges / 64 plus the number of such edges
+    template <typename Visitor> void forEachOverflowedEdge(Visitor visit) const;
+    // Sets selected[netIndex] for every net whose tree, committed with its net index, has an edge with more than
+    // overflowThreshold overflow (as checkOverflow(tree, overflowThreshold) > 0). Returns the number of entries of
+    // netTileIndex scanned.
+    int64_t selectOverflowingNets(const int overflowThreshold, vector<char>& selected) const;
    
     // 2D maps
     void extractCongestionView(GridGraphView<bool>& view) const; // 2D overflow look-up table
-    void updateCongestionView(GridGraphView<bool>& view, const std::shared_ptr<GRTreeNode> routingTree) const;
+    void updateCongestionView(GridGraphView<bool>& view, const GRTree& routingTree) const;
+    // 2D wire costs: the cost of one more wire on the cheapest layer of each edge direction
     void extractWireCostView(GridGraphView<CostT>& view) const;
-    void updateWireCostView(GridGraphView<CostT>& view, std::shared_ptr<GRTreeNode> routingTree) const;
+    void updateWireCostView(GridGraphView<CostT>& view, const GRTree& routingTree) const;
 
     // For visualization
     void writeHeatmap(const std::string heatmap_file="heatmap.txt") const;
@@ -76,9 +112,26 @@ public:
     CostT UnitViaCost;
     vector<CostT> OFWeight; // overflow weights
 
-    DBU totalLength = 0;
-    int totalNumVias = 0;
-    vector<vector<vector<GraphEdge>>> graphEdges; // gridEdges[l][x][y] stores the edge {(l, x, y), (l, x+1, y)} or {(l, x, y), (l, x, y+1)}, depending on the routing direction of the layer
+    std::atomic<DBU> totalLength{0};
+    std::atomic<int> totalNumVias{0};
+    // edgeData[l] holds the capacities of layer l, then the history costs of its edges (each block edgeStride long,
+    // 64-byte aligned). Both only change while no net is being routed.
+    // The edge at getEdgeIndex(l, x, y) is {(l, x, y), (l, x+1, y)} or {(l, x, y), (l, x, y+1)}, depending on the routing direction of the layer
+    vector<vector<CapacityT, utils::AlignedAllocator<CapacityT>>> edgeData;
+    size_t edgeStride;
+    inline CostT* getHistories(const int layerIndex) { return edgeData[layerIndex].data() + edgeStride; }
+    // edgeDemands[l]: demands of the edges of layer l, in the order of edgeData. Nets are routed without locks
+    // (NetScheduler::runOptimistic) while other nets commit, so every demand is read and written atomically. Relaxed
+    // order is enough: the tile locks or the conflict DAG order the commits of an edge and publish them.
+    vector<std::unique_ptr<std::atomic<CapacityT>[]>> edgeDemands;
+    static_assert(std::atomic<CapacityT>::is_always_lock_free, "demands are read while routing");
+    // Adds delta to the demand of an edge and returns the new demand
+    CapacityT addDemand(const int layerIndex, const size_t edgeIndex, const CapacityT delta);
+    bool hasHistoryCosts = false;
+    // overflowBits[l]: one bit per edge of layer l, in the order of edgeData, set while the edge has a negative resource.
+    // Kept up to date by commit() and commitWire(); atomic because nets routed in parallel may share a word
+    vector<std::unique_ptr<std::atomic<uint64_t>[]>> overflowBits;
+    void updateOverflowBit(const int layerIndex, const size_t edgeIndex);
 
     // utils::IntervalT<int> rangeSearchGridlines(const unsigned dimension, const utils::IntervalT<DBU>& locInterval) const; // Find the gridlines within [locInterval.low, locInterval.high]
     // utils::IntervalT<int> rangeSearchRows(const unsigned dimension, const utils::IntervalT<DBU>& locInterval) const; // Find the rows/columns overlapping with [locInterval.low, locInterval.high]
@@ -89,12 +142,23 @@ public:
 
     inline CostT getUnitLengthWireCost() const { return UnitLengthWireCost; }
 
+    // Segment costs served from prefix sums, kept up to date by commit() and commitWire()
+    WireCostCache wireCostCache;
+    // Via stacks of gcells, invalidated by commit() and commitWire()
+    ViaCostCache viaCostCache;
+    // Nets of the trees committed with a net index, by the edges they use
+    NetTileIndex netTileIndex;
+    CostT sumWireCost(const int layerIndex, const utils::PointT<int> u, const utils::PointT<int> v) const;
+    // Costs of the edges [low, high) of a track, one getWireCost(layerIndex, lower) term per edge
+    void getWireCosts(const int layerIndex, const int track, const int low, const int high, CostT* costs) const;
+
     inline double logistic(const CapacityT& input, bool s) const;
     CostT getWireCost(const int layerIndex, const utils::PointT<int> lower, const CapacityT demand = 1.0) const;
+    CostT getWireCostViewEntry(const unsigned direction, const int x, const int y) const;
 
     // Methods for updating demands 
     void commit(const int layerIndex, const utils::PointT<int> lower, const CapacityT demand);
-    void commitWire(const int layerIndex, const utils::PointT<int> lower, const bool reverse = false);
+    void commitWire(const int layerIndex, const utils::PointT<int> u, const utils::PointT<int> v, const bool reverse = false);
     void commitVia(const int layerIndex, const utils::PointT<int> loc, const bool reverse = false, bool isStackedVia = false);
 
     // for getEdgeLength()
@@ -103,6 +167,26 @@ public:
 };
 
 
+template <typename Visitor>
+void GridGraph::forEachOverflowedEdge(Visitor visit) const {
+    const size_t numWords = (edgeStride + 63) / 64;
+    for (unsigned layerIndex = 0; layerIndex < nLayers; layerIndex++) {
+        const unsigned trackLength = getSize(layerDirections[layerIndex]);
+        for (size_t word = 0; word < numWords; word++) {
+            uint64_t bits = overflowBits[layerIndex][word].load(std::memory_order_relaxed);
+            while (bits) {
+                const size_t edgeIndex = word * 64 + __builtin_ctzll(bits);
+                bits &= bits - 1;
+                const int track = edgeIndex / trackLength, position = edgeIndex % trackLength;
+                if (layerDirections[layerIndex] == 0)
+                    visit(layerIndex, position, track);
+                else
+                    visit(layerIndex, track, position);
+            }
+        }
+    }
+}
+
 template <typename Type>
 class GridGraphView: public vector<vector<vector<Type>>> {
 public:
@@ -1,6 +1,6 @@
 #include "MazeRoute.h"
 
-void SparseGraph::init(GridGraphView<CostT>& wireCostView, SparseGrid& grid) {
+void SparseGraph::init(GridGraphView<CostT>& wireCostView, SparseGrid& grid, const utils::BoxT<int>& area) {
     // 0. Create pseudo pins
     robin_hood::unordered_map<uint64_t, std::pair<utils::PointT<int>, utils::IntervalT<int>>> selectedAccessPoints;
     gridGraph.selectAccessPoints(net, selectedAccessPoints);
@@ -19,31 +19,31 @@ void SparseGraph::init(GridGraphView<CostT>& wireCostView, SparseGrid& grid) {
     std::sort(pxs.begin(), pxs.end());
     std::sort(pys.begin(), pys.end());
     
-    const int xSize = gridGraph.getSize(0);
-    const int ySize = gridGraph.getSize(1);
-    xs.reserve(xSize / grid.interval.x + pxs.size());
-    ys.reserve(ySize / grid.interval.y + pys.size());
+    // Grid lines at offset + i * interval inside the area, plus those of the pseudo pins
+    auto firstLine = [](const int low, const int interval, const int offset) {
+        return low + ((offset - low) % interval + interval) % interval;
+    };
+    xs.reserve(area.x.range() / grid.interval.x + 1 + pxs.size());
+    ys.reserve(area.y.range() / grid.interval.y + 1 + pys.size());
     int j = 0;
-    for (int i = 0; true; i++) {
-        int x = i * grid.interval.x + grid.offset.x;
+    for (int x = firstLine(area.lx(), grid.interval.x, grid.offset.x); true; x += grid.interval.x) {
         for ( ; j < pxs.size() && pxs[j] <= x; j++) {
             if ((xs.size() > 0 && pxs[j] == xs.back()) || pxs[j] == x) continue;
             xs.emplace_back(pxs[j]);
         }
-        if (x < xSize) {
+        if (x <= area.hx()) {
             xs.emplace_back(x);
         } else {
             break;
         }
     }
     j = 0;
-    for (int i = 0; true; i++) {
-        int y = i * grid.interval.y + grid.offset.y;
+    for (int y = firstLine(area.ly(), grid.interval.y, grid.offset.y); true; y += grid.interval.y) {
         for ( ; j < pys.size() && pys[j] <= y; j++) {
             if ((ys.size() > 0 && pys[j] == ys.back()) || pys[j] == y) continue;
             ys.emplace_back(pys[j]);
         }
-        if (y < ySize) {
+        if (y <= area.hy()) {
             ys.emplace_back(y);
         } else {
             break;
@@ -126,63 +126,211 @@ void SparseGraph::init(GridGraphView<CostT>& wireCostView, SparseGrid& grid) {
     }
 }
 
-void MazeRoute::run() {
-    vector<CostT> minCosts(graph.getNumVertices(), std::numeric_limits<CostT>::max());
-    solutions.reserve(net.getNumPins());
-    auto compareSolution = [&] (const std::shared_ptr<Solution>& lhs, const std::shared_ptr<Solution>& rhs) {
-        return lhs->cost > rhs->cost;
+namespace {
+// Search state of MazeRoute::run(), kept per thread so that nets routed one after another reuse the buffers
+struct MazeScratch {
+    struct Entry {
+        CostT key;   // cost, plus the heuristic in A* mode
+        CostT cost;
+        int vertex;
     };
-    std::priority_queue<
-        std::shared_ptr<Solution>, vector<std::shared_ptr<Solution>>, decltype(compareSolution)
-    > queue(compareSolution);
-    auto updateSolution = [&] (const std::shared_ptr<Solution>& solution) {
-        queue.push(solution);
-        if (solution->cost < minCosts[solution->vertex]) minCosts[solution->vertex] = solution->cost;
+    vector<CostT> minCosts;
+    vector<int> parents;  // vertex from which minCosts[v] was reached, -1 for the start pin
+    vector<char> onPath;  // already in pathVertices
+    vector<Entry> queue;  // binary heap, stale entries are skipped when popped
+    vector<int> touched;  // vertices with a finite minCosts in the current A* search
+    vector<CostT> heuristics;  // A* heuristic of each vertex, valid if heuristicSearches matches the current search
+    vector<unsigned> heuristicSearches;
+    unsigned search = 0;  // A* searches run by this thread, so that the heuristics need no reset between them (never 0)
+    vector<DBU> positions[2];  // positions[d][i]: total length of the edges before gcell i along direction d
+};
+thread_local MazeScratch scratch;
+
+bool compareEntry(const MazeScratch::Entry& lhs, const MazeScratch::Entry& rhs) {
+    return lhs.key > rhs.key;
+}
+}  // namespace
+
+bool MazeRoute::run(const bool astar) {
+    const int numVertices = graph.getNumVertices();
+    scratch.minCosts.assign(numVertices, std::numeric_limits<CostT>::max());
+    scratch.parents.assign(numVertices, -1);
+    scratch.onPath.assign(numVertices, false);
+    scratch.queue.clear();
+    pathVertices.clear();
+    pathStarts.clear();
+    numExpanded = 0;
+    const bool connected = astar ? runAStar() : runDijkstra();
+    pathStarts.push_back(pathVertices.size());
+    return connected;
+}
+
+void MazeRoute::recordPath(const int foundVertex) {
+    pathStarts.push_back(pathVertices.size());
+    for (int vertex = foundVertex; vertex != -1; vertex = scratch.parents[vertex]) {
+        pathVertices.push_back(vertex);
+        if (scratch.onPath[vertex]) break;
+        scratch.onPath[vertex] = true;
+    }
+}
+
+bool MazeRoute::runDijkstra() {
+    // Same pushes, pops and heap order as a std::priority_queue of whole paths, so the trees are the same; a path is
+    // now a chain of parents instead of a shared_ptr per relaxation
+    vector<CostT>& minCosts = scratch.minCosts;
+    vector<int>& parents = scratch.parents;
+    vector<MazeScratch::Entry>& queue = scratch.queue;
+    auto updateSolution = [&] (const CostT cost, const int vertex) {
+        queue.push_back({cost, cost, vertex});
+        std::push_heap(queue.begin(), queue.end(), compareEntry);
+        if (cost < minCosts[vertex]) minCosts[vertex] = cost;
     };
     
     vector<bool> visited(net.getNumPins(), false);
     const int startPinIndex = 0;
     visited[startPinIndex] = true;
     int numDetached = graph.getNumPseudoPins() - 1;
-    updateSolution(std::make_shared<Solution>(0, graph.getPinVertex(startPinIndex), nullptr));
+    updateSolution(0, graph.getPinVertex(startPinIndex));
     
     while (numDetached > 0) {
-        std::shared_ptr<Solution> foundSolution;
-        int foundPinIndex;
-        while(!queue.empty()) {
-            auto solution = queue.top();
-            queue.pop();
-            foundPinIndex = graph.getVertexPin(solution->vertex);
+        int foundVertex = -1;
+        int foundPinIndex = -1;
+        while (!queue.empty()) {
+            const MazeScratch::Entry entry = queue.front();
+            std::pop_heap(queue.begin(), queue.end(), compareEntry);
+            queue.pop_back();
+            foundPinIndex = graph.getVertexPin(entry.vertex);
             if (foundPinIndex != -1 && !visited[foundPinIndex]) {
-                foundSolution = solution;
+                foundVertex = entry.vertex;
                 break;
             }
             // Pruning
-            if (solution->cost > minCosts[solution->vertex]) continue;
+            if (entry.cost > minCosts[entry.vertex]) continue;
+            numExpanded++;
             for (int edgeIndex = 0; edgeIndex < 3; edgeIndex++) {
-                int nextVertex = graph.getNextVertex(solution->vertex, edgeIndex);
-                if (nextVertex == -1 || (solution->prev && nextVertex == solution->prev->vertex)) continue;
-                CostT nextCost = solution->cost + graph.getEdgeCost(solution->vertex, edgeIndex);
-                if (nextCost < minCosts[nextVertex]) 
-                    updateSolution(std::make_shared<Solution>(nextCost, nextVertex, solution));
+                int nextVertex = graph.getNextVertex(entry.vertex, edgeIndex);
+                if (nextVertex == -1 || nextVertex == parents[entry.vertex]) continue;
+                CostT nextCost = entry.cost + graph.getEdgeCost(entry.vertex, edgeIndex);
+                if (nextCost < minCosts[nextVertex]) {
+                    parents[nextVertex] = entry.vertex;
+                    updateSolution(nextCost, nextVertex);
+                }
             }
         }
+        if (foundVertex == -1)
+            break;
         
-        solutions.emplace_back(foundSolution);
         visited[foundPinIndex] = true;
         numDetached -= 1; 
+        recordPath(foundVertex);
         
         // Update the cost of the vertices on the path
-        std::shared_ptr<Solution> temp = foundSolution;
-        while (temp && temp->cost != 0) {
-            updateSolution(std::make_shared<Solution>(0, temp->vertex, temp->prev));
-            temp = temp->prev;
+        for (int vertex = foundVertex; vertex != -1 && minCosts[vertex] != 0; vertex = parents[vertex]) {
+            updateSolution(0, vertex);
         }
     }
     
-    if (numDetached != 0) {
-        cout << "Error: failed to connect all pins." << endl;
+    return numDetached == 0;
+}
+
+bool MazeRoute::runAStar() {
+    // Every connection is a fresh search from the whole tree so far. The heuristic is the wire cost of the shortest
+    // Manhattan path to the nearest unconnected pin. Edge costs are at least their length times the unit wire cost,
+    // so it never overestimates. Vias are left out: they are free at pins, so a path may turn at no cost.
+    vector<CostT>& minCosts = scratch.minCosts;
+    vector<int>& parents = scratch.parents;
+    vector<MazeScratch::Entry>& queue = scratch.queue;
+    vector<int>& touched = scratch.touched;
+    for (unsigned direction = 0; direction < 2; direction++) {
+        vector<DBU>& positions = scratch.positions[direction];
+        const int size = gridGraph.getSize(direction);
+        if (positions.size() == size)
+            continue;
+        positions.assign(size, 0);
+        for (int i = 0; i + 1 < size; i++) positions[i + 1] = positions[i] + gridGraph.getEdgeLength(direction, i);
+    }
+    const vector<DBU>& xPositions = scratch.positions[0];
+    const vector<DBU>& yPositions = scratch.positions[1];
+    const CostT unitCost = gridGraph.getUnitLengthWireCost();
+    
+    // The remaining pins only change between searches, so the heuristic of a vertex is computed once per search
+    vector<int> remainingPins;  // unconnected pins
+    vector<char> isRemaining(graph.getNumPseudoPins(), true);
+    isRemaining[0] = false;
+    for (int pinIndex = 1; pinIndex < graph.getNumPseudoPins(); pinIndex++) remainingPins.push_back(pinIndex);
+    vector<CostT>& heuristics = scratch.heuristics;
+    vector<unsigned>& heuristicSearches = scratch.heuristicSearches;
+    if (heuristics.size() < graph.getNumVertices()) {
+        heuristics.resize(graph.getNumVertices());
+        heuristicSearches.resize(graph.getNumVertices(), 0);
     }
+    auto nextSearch = [&] () {
+        if (++scratch.search != 0) return;
+        std::fill(heuristicSearches.begin(), heuristicSearches.end(), 0);  // wrapped around
+        scratch.search = 1;
+    };
+    nextSearch();
+    auto heuristic = [&] (const int vertex) {
+        if (heuristicSearches[vertex] == scratch.search) return heuristics[vertex];
+        const GRPoint point = graph.getPoint(vertex);
+        DBU distance = std::numeric_limits<DBU>::max();
+        for (int pinIndex : remainingPins) {
+            const utils::PointT<int>& pin = graph.getPseudoPin(pinIndex).first;
+            distance = std::min(distance, std::abs(xPositions[point.x] - xPositions[pin.x]) + std::abs(yPositions[point.y] - yPositions[pin.y]));
+        }
+        heuristicSearches[vertex] = scratch.search;
+        heuristics[vertex] = distance * unitCost;
+        return heuristics[vertex];
+    };
+    auto updateSolution = [&] (const CostT cost, const int vertex) {
+        if (minCosts[vertex] == std::numeric_limits<CostT>::max()) touched.push_back(vertex);
+        minCosts[vertex] = cost;
+        queue.push_back({cost + heuristic(vertex), cost, vertex});
+        std::push_heap(queue.begin(), queue.end(), compareEntry);
+    };
+    
+    touched.clear();
+    updateSolution(0, graph.getPinVertex(0));
+    while (!remainingPins.empty()) {
+        int foundVertex = -1;
+        while (!queue.empty()) {
+            const MazeScratch::Entry entry = queue.front();
+            std::pop_heap(queue.begin(), queue.end(), compareEntry);
+            queue.pop_back();
+            if (entry.cost > minCosts[entry.vertex]) continue;
+            const int pinIndex = graph.getVertexPin(entry.vertex);
+            if (pinIndex != -1 && isRemaining[pinIndex]) {
+                foundVertex = entry.vertex;
+                isRemaining[pinIndex] = false;
+                remainingPins.erase(std::find(remainingPins.begin(), remainingPins.end(), pinIndex));
+                break;
+            }
+            numExpanded++;
+            for (int edgeIndex = 0; edgeIndex < 3; edgeIndex++) {
+                int nextVertex = graph.getNextVertex(entry.vertex, edgeIndex);
+                if (nextVertex == -1 || nextVertex == parents[entry.vertex]) continue;
+                CostT nextCost = entry.cost + graph.getEdgeCost(entry.vertex, edgeIndex);
+                if (nextCost < minCosts[nextVertex]) {
+                    parents[nextVertex] = entry.vertex;
+                    updateSolution(nextCost, nextVertex);
+                }
+            }
+        }
+        if (foundVertex == -1)
+            break;
+        recordPath(foundVertex);
+        nextSearch();
+        
+        // Restart from every vertex of the tree, whose parents stay as they are
+        for (int vertex : touched) minCosts[vertex] = std::numeric_limits<CostT>::max();
+        touched.clear();
+        queue.clear();
+        for (int k = 0; k < pathVertices.size(); k++) {
+            if (minCosts[pathVertices[k]] != 0) updateSolution(0, pathVertices[k]);
+        }
+    }
+    
+    return remainingPins.empty();
 }
 
 
@@ -194,27 +342,26 @@ std::shared_ptr<SteinerTreeNode> MazeRoute::getSteinerTree() const {
         return tree;
     }
     
-    vector<bool> visited(net.getNumPins(), false);
+    const int startVertex = graph.getPinVertex(0);
     robin_hood::unordered_map<int, std::shared_ptr<SteinerTreeNode>> created;
-    for (auto& solution : solutions) {
-        std::shared_ptr<Solution> temp = solution;
+    for (int p = 0; p + 1 < pathStarts.size(); p++) {
         std::shared_ptr<SteinerTreeNode> lastNode = nullptr;
-        while (temp) {
-            auto it = created.find(temp->vertex);
+        for (int k = pathStarts[p]; k < pathStarts[p + 1]; k++) {
+            const int vertex = pathVertices[k];
+            auto it = created.find(vertex);
             if (it == created.end()) {
-                utils::PointT<int> point = graph.getPoint(temp->vertex);
+                utils::PointT<int> point = graph.getPoint(vertex);
                 auto node = std::make_shared<SteinerTreeNode>(point);
-                created.emplace(temp->vertex, node);
+                created.emplace(vertex, node);
                 if (lastNode) node->children.emplace_back(lastNode);
-                if (!temp->prev) tree = node;
-                if (!lastNode || !temp->prev) {
+                if (vertex == startVertex) tree = node;
+                if (!lastNode || vertex == startVertex) {
                     // Both the start and the end of the path should contain pins
-                    int pinIndex = graph.getVertexPin(temp->vertex);
+                    int pinIndex = graph.getVertexPin(vertex);
                     assert(pinIndex != -1);
                     node->fixedLayers = graph.getPseudoPin(pinIndex).second;
                 }
                 lastNode = node;
-                temp = temp->prev;
             } else {
                 if (lastNode) it->second->children.emplace_back(lastNode);
                 break;
@@ -13,6 +13,11 @@ struct SparseGrid {
         offset.x = (offset.x + 1) % interval.x;
         offset.y = (offset.y + 1) % interval.y;
     }
+    // Offsets after n calls to step() from zero, so that nets routed in parallel get the grid lines of the serial order
+    void seek(int n) {
+        offset.x = n % interval.x;
+        offset.y = n % interval.y;
+    }
     void reset(int xInterval, int yInterval) {
         interval.x = xInterval;
         interval.y = yInterval;
@@ -25,7 +30,8 @@ class SparseGraph {
 public:
     SparseGraph(GRNet& _net, const GridGraph& graph3d, const Parameters& param):
         net(_net), gridGraph(graph3d), parameters(param) {}
-    void init(GridGraphView<CostT>& wireCostView, SparseGrid& grid);
+    // Grid lines inside area only, which must contain all the pins of the net
+    void init(GridGraphView<CostT>& wireCostView, SparseGrid& grid, const utils::BoxT<int>& area);
     int getNumVertices() const { return vertices.size(); }
     int getNumPseudoPins() const { return pseudoPins.size(); }
     std::pair<utils::PointT<int>, utils::IntervalT<int>> getPseudoPin(int pinIndex) const { return pseudoPins[pinIndex]; }
@@ -61,22 +67,19 @@ private:
     
 };
 
-struct Solution {
-    CostT cost;
-    int vertex;
-    std::shared_ptr<Solution> prev;
-    Solution(CostT c, int v, const std::shared_ptr<Solution> &p): cost(c), vertex(v), prev(p) {}
-};
-
 class MazeRoute {
 public:
     MazeRoute(GRNet& _net, const GridGraph& graph3d, const Parameters& param):
         net(_net), gridGraph(graph3d), parameters(param), graph(_net, graph3d, param) {}
     
-    void run();
-    void constructSparsifiedGraph(GridGraphView<CostT>& wireCostView, SparseGrid& grid) {
-        graph.init(wireCostView, grid);
+    // Joins the nearest unconnected pin to the tree so far by a cheapest path until all pins are connected; false if
+    // some pin could not be reached. The A* search breaks ties differently but expands fewer vertices.
+    bool run(const bool astar = false);
+    void constructSparsifiedGraph(GridGraphView<CostT>& wireCostView, SparseGrid& grid, const utils::BoxT<int>& area) {
+        graph.init(wireCostView, grid, area);
     }
+    int getNumVertices() const { return graph.getNumVertices(); }
+    int getNumExpanded() const { return numExpanded; }  // vertices expanded by the last run()
     std::shared_ptr<SteinerTreeNode> getSteinerTree() const;
     
 private: 
@@ -85,5 +88,13 @@ private:
     GRNet& net;
     SparseGraph graph;
     
-    vector<std::shared_ptr<Solution>> solutions;
-};
\ No newline at end of file
+    // Paths found by run(), one after another: each goes from a pin back to the vertex where it joins the tree
+    // found so far (included), or to the start pin for the first one
+    vector<int> pathVertices;
+    vector<int> pathStarts;
+    int numExpanded = 0;
+
+    bool runDijkstra();
+    bool runAStar();
+    void recordPath(const int foundVertex);
+};
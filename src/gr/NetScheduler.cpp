@@ -0,0 +1,231 @@
+#include "NetScheduler.h"
+#include <deque>
+#include <mutex>
+#include <thread>
+
+NetScheduler::NetScheduler(const vector<utils::BoxT<int>>& areas, const int xSize, const int ySize)
+    : xTiles((xSize + TileSize - 1) / TileSize), yTiles((ySize + TileSize - 1) / TileSize) {
+    tileAreas.resize(areas.size());
+    for (size_t i = 0; i < areas.size(); ++i) {
+        const utils::BoxT<int>& area = areas[i];
+        tileAreas[i].Set(std::max(area.lx(), 0) / TileSize, std::max(area.ly(), 0) / TileSize,
+                         std::min(area.hx(), xSize - 1) / TileSize, std::min(area.hy(), ySize - 1) / TileSize);
+    }
+}
+
+void NetScheduler::buildConflictGraph() {
+    const int numNets = tileAreas.size();
+    vector<int> lastNet(xTiles * yTiles, -1);  // last net so far touching each tile
+    vector<int> marked(numNets, -1);           // marked[p] == i: p is already a predecessor of i
+    depth.assign(numNets, 1);
+    vector<std::pair<int, int>> edges;
+    numPredecessors.assign(numNets, 0);
+    criticalPath = 0;
+
+    for (int i = 0; i < numNets; ++i) {
+        const utils::BoxT<int>& area = tileAreas[i];
+        for (int x = area.lx(); x <= area.hx(); ++x) {
+            for (int y = area.ly(); y <= area.hy(); ++y) {
+                int& last = lastNet[x * yTiles + y];
+                if (last >= 0 && marked[last] != i) {
+                    marked[last] = i;
+                    edges.emplace_back(last, i);
+                    numPredecessors[i]++;
+                    depth[i] = std::max(depth[i], depth[last] + 1);
+                }
+                last = i;
+            }
+        }
+        criticalPath = std::max(criticalPath, depth[i]);
+    }
+
+    successorStart.assign(numNets + 1, 0);
+    for (const auto& edge : edges) successorStart[edge.first + 1]++;
+    for (int i = 0; i < numNets; ++i) successorStart[i + 1] += successorStart[i];
+    successors.resize(edges.size());
+    vector<int> next(successorStart.begin(), successorStart.end() - 1);
+    for (const auto& edge : edges) successors[next[edge.first]++] = edge.second;
+}
+
+void NetScheduler::run(const int threadNum, const std::function<void(int)>& task) {
+    buildConflictGraph();
+    const int numNets = numPredecessors.size();
+    if (numNets == 0)
+        return;
+    struct TaskDeque {
+        std::mutex mutex;
+        std::deque<int> tasks;
+    };
+    vector<TaskDeque> deques(threadNum);
+    std::unique_ptr<std::atomic<int>[]> waiting(new std::atomic<int>[numNets]);
+    int numReady = 0;
+    for (int i = numNets - 1; i >= 0; --i) {  // owners start from the back, i.e. in routing order
+        waiting[i].store(numPredecessors[i], std::memory_order_relaxed);
+        if (numPredecessors[i] == 0)
+            deques[numReady++ % threadNum].tasks.push_back(i);
+    }
+    std::atomic<int> remaining(numNets);
+
+#pragma omp parallel num_threads(threadNum)
+    {
+        const int self = omp_get_thread_num();
+        while (remaining.load(std::memory_order_acquire) > 0) {
+            int i = -1;
+            {
+                std::lock_guard<std::mutex> lock(deques[self].mutex);
+                if (!deques[self].tasks.empty()) {
+                    i = deques[self].tasks.back();
+                    deques[self].tasks.pop_back();
+                }
+            }
+            for (int k = 1; i < 0 && k < threadNum; ++k) {
+                TaskDeque& victim = deques[(self + k) % threadNum];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.tasks.empty()) {
+                    i = victim.tasks.front();
+                    victim.tasks.pop_front();
+                }
+            }
+            if (i < 0) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            task(i);
+            for (int k = successorStart[i]; k < successorStart[i + 1]; ++k) {
+                const int successor = successors[k];
+                if (waiting[successor].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    std::lock_guard<std::mutex> lock(deques[self].mutex);
+                    deques[self].tasks.push_back(successor);
+                }
+            }
+            remaining.fetch_sub(1, std::memory_order_release);
+        }
+    }
+}
+
+void NetScheduler::getBatches(vector<vector<int>>& batches) {
+    buildConflictGraph();
+    batches.assign(criticalPath, {});
+    for (int i = 0; i < (int)depth.size(); ++i) batches[depth[i] - 1].push_back(i);
+}
+
+void NetScheduler::printWaves() const {
+    vector<int> waveSizes(criticalPath, 0);
+    for (int d : depth) waveSizes[d - 1]++;
+    // Waves of 1, 2-3, 4-7, ... nets
+    vector<int> histogram;
+    int numSerial = 0, largest = 0;
+    for (int size : waveSizes) {
+        int bucket = 0;
+        while ((2 << bucket) <= size) bucket++;
+        if ((int)histogram.size() <= bucket)
+            histogram.resize(bucket + 1, 0);
+        histogram[bucket]++;
+        numSerial += size == 1;
+        largest = std::max(largest, size);
+    }
+    std::cout << "[INFO] Waves: " << criticalPath << ", by size";
+    for (size_t bucket = 0; bucket < histogram.size(); ++bucket) {
+        if (histogram[bucket] == 0)
+            continue;
+        std::cout << (bucket == 0 ? " " : ", ") << (1 << bucket);
+        if (bucket > 0)
+            std::cout << "-" << (2 << bucket) - 1;
+        std::cout << ": " << histogram[bucket];
+    }
+    std::cout << ", largest " << largest << "; serial fraction " << numSerial << " / " << depth.size() << " nets ("
+              << (depth.empty() ? 0.0 : 100.0 * numSerial / depth.size()) << "%)" << std::endl;
+}
+
+int NetScheduler::runOptimistic(const int threadNum, const std::function<void(int)>& ripUp, const std::function<void(int)>& route,
+                                const std::function<void(int)>& commit) {
+    const int numNets = tileAreas.size();
+    versions.reset(new std::atomic<uint32_t>[xTiles * yTiles]());
+    int numRetries = 0;
+
+#pragma omp parallel for schedule(dynamic, 16) num_threads(threadNum) reduction(+ : numRetries)
+    for (int i = 0; i < numNets; ++i) {
+        static thread_local vector<uint32_t> snapshot;
+        if (ripUp) {
+            lockTiles(i);
+            ripUp(i);
+            unlockTiles(i);
+        }
+        for (int attempt = 0;; ++attempt) {
+            if (attempt == MaxOptimisticAttempts) {
+                // Busy area: route while holding the tiles so that the net cannot fail again
+                lockTiles(i);
+                route(i);
+                commit(i);
+                unlockTiles(i);
+                break;
+            }
+            const utils::BoxT<int>& area = tileAreas[i];
+            snapshot.clear();
+            for (int x = area.lx(); x <= area.hx(); ++x) {
+                for (int y = area.ly(); y <= area.hy(); ++y) {
+                    uint32_t version;
+                    while ((version = versions[x * yTiles + y].load(std::memory_order_acquire)) & 1) std::this_thread::yield();
+                    snapshot.push_back(version);
+                }
+            }
+            route(i);
+            if (lockTilesIfUnchanged(i, snapshot)) {
+                commit(i);
+                unlockTiles(i);
+                break;
+            }
+            numRetries++;
+        }
+    }
+    return numRetries;
+}
+
+void NetScheduler::lockTiles(const int i) {
+    // Tiles are always taken in the same order, so two nets never wait for each other
+    const utils::BoxT<int>& area = tileAreas[i];
+    for (int x = area.lx(); x <= area.hx(); ++x) {
+        for (int y = area.ly(); y <= area.hy(); ++y) {
+            std::atomic<uint32_t>& version = versions[x * yTiles + y];
+            uint32_t current = version.load(std::memory_order_relaxed);
+            while ((current & 1) || !version.compare_exchange_weak(current, current + 1, std::memory_order_acquire)) {
+                std::this_thread::yield();
+                current = version.load(std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+bool NetScheduler::lockTilesIfUnchanged(const int i, const vector<uint32_t>& snapshot) {
+    const utils::BoxT<int>& area = tileAreas[i];
+    int numLocked = 0;
+    bool unchanged = true;
+    for (int x = area.lx(); unchanged && x <= area.hx(); ++x) {
+        for (int y = area.ly(); unchanged && y <= area.hy(); ++y) {
+            uint32_t expected = snapshot[numLocked];
+            if (versions[x * yTiles + y].compare_exchange_strong(expected, expected + 1, std::memory_order_acquire))
+                numLocked++;
+            else
+                unchanged = false;
+        }
+    }
+    if (unchanged)
+        return true;
+    // Give back the tiles taken so far with their old versions: nothing was modified
+    for (int x = area.lx(), k = 0; k < numLocked; ++x) {
+        for (int y = area.ly(); k < numLocked && y <= area.hy(); ++y, ++k) {
+            versions[x * yTiles + y].store(snapshot[k], std::memory_order_release);
+        }
+    }
+    return false;
+}
+
+void NetScheduler::unlockTiles(const int i) {
+    const utils::BoxT<int>& area = tileAreas[i];
+    for (int x = area.lx(); x <= area.hx(); ++x) {
+        for (int y = area.ly(); y <= area.hy(); ++y) {
+            versions[x * yTiles + y].fetch_add(1, std::memory_order_release);
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <memory>
+#include "../global.h"
+
+// Runs one task per net on a pool of threads. The area a net may touch is mapped to tiles of a coarse grid.
+//
+// run() gives the same result as running the tasks one after another in the given order. Every net waits for the
+// last earlier net on each of its tiles (conflict DAG) and becomes ready when all its predecessors are done. Ready
+// nets go to the deque of the thread that released them; the owner takes the newest one and idle threads steal the
+// oldest one from the other deques, so no core sits idle while there is an independent net left.
+//
+// getBatches() groups the nets by their depth in the conflict DAG. The nets of a batch are independent of each
+// other and only depend on earlier batches, so running the batches one after another, each in parallel, also gives
+// the result of the serial order.
+//
+// runOptimistic() lets any net route on any thread and only serializes the commits. Every tile has a version that
+// doubles as a spinlock (odd while locked). A net is routed without locks, then its tiles are locked only if none
+// of their versions changed meanwhile; otherwise it is routed again. Commits to the same edge are serialized by the
+// tile locks. The result depends on the timing of the threads.
+class NetScheduler {
+public:
+    // areas[i]: gcells task i may read or modify, in routing order
+    NetScheduler(const vector<utils::BoxT<int>>& areas, const int xSize, const int ySize);
+
+    // Calls task(i) for every i
+    void run(const int threadNum, const std::function<void(int)>& task);
+    // batches[b]: tasks at depth b + 1 of the conflict DAG, in the given order
+    void getBatches(vector<vector<int>>& batches);
+    // Calls route(i) and then commit(i) for every i; route(i) must not modify shared state. ripUp(i), if given, is
+    // called before the first route(i) with the tiles of i locked. Returns the number of nets routed again.
+    int runOptimistic(const int threadNum, const std::function<void(int)>& ripUp, const std::function<void(int)>& route,
+                      const std::function<void(int)>& commit);
+
+    int getNumEdges() const { return successors.size(); }
+    int getCriticalPath() const { return criticalPath; }  // longest chain of dependent nets
+    // Logs the waves of the conflict DAG (the batches of getBatches()) by size, and the serial fraction: the share
+    // of nets in waves of a single net, which cannot run next to any other net. Needs run() or getBatches() first.
+    void printWaves() const;
+
+private:
+    static constexpr int TileSize = 4;
+    static constexpr int MaxOptimisticAttempts = 3;  // then the tiles are locked before routing
+
+    int xTiles;
+    int yTiles;
+    vector<utils::BoxT<int>> tileAreas;  // areas in tiles
+
+    // Conflict DAG of run()
+    vector<int> successorStart;   // successors of net i: successors[successorStart[i] .. successorStart[i + 1])
+    vector<int> successors;
+    vector<int> numPredecessors;
+    vector<int> depth;  // longest chain of dependent nets ending at net i
+    int criticalPath = 0;
+
+    // Tile versions of runOptimistic()
+    std::unique_ptr<std::atomic<uint32_t>[]> versions;
+
+    void buildConflictGraph();
+    void lockTiles(const int i);
+    bool lockTilesIfUnchanged(const int i, const vector<uint32_t>& snapshot);
+    void unlockTiles(const int i);  // with new versions
+};
@@ -0,0 +1,75 @@
+#include "NetTileIndex.h"
+
+void NetTileIndex::init(const unsigned numLayers, const unsigned xSize, const unsigned ySize) {
+    this->numLayers = numLayers;
+    xTiles = (xSize + TileSize - 1) / TileSize;
+    yTiles = (ySize + TileSize - 1) / TileSize;
+    tiles.reset(new Tile[xTiles * yTiles]);
+}
+
+void NetTileIndex::update(const GRTree& tree, const int netIndex, const bool reverse, const vector<unsigned>& layerDirections) {
+    // (tile * numLayers + layer, edges) of the tree, merged per tile and layer
+    static thread_local vector<std::pair<uint64_t, uint64_t>> pieces;
+    pieces.clear();
+    auto addEdge = [&](const int layerIndex, const int x, const int y) {
+        pieces.emplace_back(getTileIndex(x, y) * numLayers + layerIndex, getEdgeBit(x, y));
+    };
+    tree.forEachEdge([&](const GRTree::Node& node, const GRTree::Node& child) {
+        if (node.layerIdx == child.layerIdx) {
+            const unsigned direction = layerDirections[node.layerIdx];
+            utils::PointT<int> lower = node;
+            const int l = std::min(node[direction], child[direction]), h = std::max(node[direction], child[direction]);
+            for (lower[direction] = l; lower[direction] < h; lower[direction]++) addEdge(node.layerIdx, lower.x, lower.y);
+        } else {
+            const int maxLayerIndex = std::max(node.layerIdx, child.layerIdx);
+            for (int layerIndex = std::min(node.layerIdx, child.layerIdx) + 1; layerIndex < maxLayerIndex; layerIndex++)
+                addEdge(layerIndex, node.x, node.y);
+        }
+    });
+    if (pieces.empty())
+        return;
+    std::sort(pieces.begin(), pieces.end());
+
+    size_t first = 0;
+    while (first < pieces.size()) {
+        const size_t tileIndex = pieces[first].first / numLayers;
+        Tile& tile = tiles[tileIndex];
+        std::lock_guard<std::mutex> lock(tile.mutex);
+        if (reverse) {
+            vector<Entry>& entries = tile.entries;
+            for (size_t k = 0; k < entries.size();) {
+                if (entries[k].netIndex == netIndex) {
+                    entries[k] = entries.back();
+                    entries.pop_back();
+                } else {
+                    k++;
+                }
+            }
+        }
+        for (; first < pieces.size() && pieces[first].first / numLayers == tileIndex;) {
+            const uint64_t key = pieces[first].first;
+            uint64_t edges = 0;
+            for (; first < pieces.size() && pieces[first].first == key; first++) edges |= pieces[first].second;
+            if (!reverse)
+                tile.entries.push_back({netIndex, int(key % numLayers), edges});
+        }
+    }
+}
+
+int64_t NetTileIndex::selectNets(const vector<uint64_t>& masks, vector<char>& selected) const {
+    int64_t numScanned = 0;
+    for (size_t tileIndex = 0; tileIndex < getNumTiles(); tileIndex++) {
+        const uint64_t* tileMasks = masks.data() + tileIndex * numLayers;
+        bool congested = false;
+        for (unsigned layerIndex = 0; layerIndex < numLayers; layerIndex++) congested |= tileMasks[layerIndex] != 0;
+        if (!congested)
+            continue;
+        const vector<Entry>& entries = tiles[tileIndex].entries;
+        numScanned += entries.size();
+        for (const Entry& entry : entries) {
+            if (entry.edges & tileMasks[entry.layerIndex])
+                selected[entry.netIndex] = true;
+        }
+    }
+    return numScanned;
+}
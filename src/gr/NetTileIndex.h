@@ -0,0 +1,46 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include "../global.h"
+#include "GRTree.h"
+
+// Reverse map from the routing resources to the nets using them, for finding the nets over overflowed edges
+// without walking every routing tree.
+//
+// The grid is cut into tiles of TileSize x TileSize gcells, so that the edges of one layer in a tile fit into the
+// bits of a uint64_t. For every committed routing tree, a tile lists one entry per layer with the edges the tree
+// uses there: its wires, and the middle layers of its stacked vias (as in GridGraph::checkOverflow). Commits of
+// different nets may run in parallel, so every tile has its own lock.
+class NetTileIndex {
+public:
+    static constexpr int TileSize = 8;
+
+    void init(const unsigned numLayers, const unsigned xSize, const unsigned ySize);
+    inline bool isInitialized() const { return tiles != nullptr; }
+
+    inline unsigned getNumTiles() const { return xTiles * yTiles; }
+    inline size_t getTileIndex(const int x, const int y) const { return (size_t)(x / TileSize) * yTiles + y / TileSize; }
+    static inline uint64_t getEdgeBit(const int x, const int y) { return uint64_t(1) << (x % TileSize * TileSize + y % TileSize); }
+
+    // Adds the edges of the routing tree of net netIndex, or removes all entries of the net from the tiles of the tree
+    void update(const GRTree& tree, const int netIndex, const bool reverse, const vector<unsigned>& layerDirections);
+    // masks[tile * numLayers + layerIndex]: edges of interest, see getEdgeBit. Sets selected[netIndex] for every net
+    // with an edge among them and returns the number of entries scanned.
+    int64_t selectNets(const vector<uint64_t>& masks, vector<char>& selected) const;
+
+private:
+    struct Entry {
+        int netIndex;
+        int layerIndex;
+        uint64_t edges;
+    };
+    struct Tile {
+        std::mutex mutex;
+        vector<Entry> entries;
+    };
+
+    unsigned numLayers = 0;
+    unsigned xTiles = 0;
+    unsigned yTiles = 0;
+    std::unique_ptr<Tile[]> tiles;
+};
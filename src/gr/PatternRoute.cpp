@@ -8,44 +8,73 @@ void SteinerTreeNode::preorder(
         preorder(child, visit);
 }
 
-void PatternRoute::constructSteinerTree() {
+SteinerTree::SteinerTree(const std::shared_ptr<SteinerTreeNode>& root) {
+    if (!root)
+        return;
+    std::function<void(const std::shared_ptr<SteinerTreeNode>&, int)> flatten = [&](const std::shared_ptr<SteinerTreeNode>& node, int parent) {
+        const int index = addNode(SteinerPoint(*node, node->fixedLayers), parent);
+        for (const auto& child : node->children) flatten(child, index);
+        closeNode(index);
+    };
+    flatten(root, -1);
+}
+
+bool PatternRoute::constructSteinerTree(const GRNet& net, const GridGraph& gridGraph, SteinerTree& tree, FluteCache* fluteCache) {
     // 1. Select access points
     robin_hood::unordered_map<uint64_t, std::pair<utils::PointT<int>, utils::IntervalT<int>>> selectedAccessPoints;
     gridGraph.selectAccessPoints(net, selectedAccessPoints);
 
+    uint64_t signature = selectedAccessPoints.size();
+    for (auto& accessPoint : selectedAccessPoints) {
+        for (uint64_t value : {accessPoint.first, (uint64_t)accessPoint.second.second.low, (uint64_t)accessPoint.second.second.high}) {
+            signature ^= value + 0x9e3779b97f4a7c15ULL + (signature << 6) + (signature >> 2);
+        }
+    }
+    if (!tree.empty() && tree.accessSignature == signature)
+        return false;
+    tree.clear();
+    tree.accessSignature = signature;
+
     // 2. Construct Steiner tree
     const int degree = selectedAccessPoints.size();
     if (degree == 1) {
         for (auto& accessPoint : selectedAccessPoints) {
-            steinerTree = std::make_shared<SteinerTreeNode>(accessPoint.second.first, accessPoint.second.second);
+            tree.closeNode(tree.addNode(SteinerPoint(accessPoint.second.first, accessPoint.second.second)));
         }
     } else {
-        //
+        // Sorted pins give FLUTE the same input for every translate of a pin pattern, see FluteCache
+        vector<utils::PointT<int>> pins;
+        pins.reserve(degree);
+        for (auto& accessPoint : selectedAccessPoints) {
+            pins.push_back(accessPoint.second.first);
+        }
+        std::sort(pins.begin(), pins.end(), [](const utils::PointT<int>& a, const utils::PointT<int>& b) {
+            return a.x < b.x || (a.x == b.x && a.y < b.y);
+        });
         int xs[degree * 4]; // xs is the x coordinates of the access points
         int ys[degree * 4];
-        int i = 0;
-        for (auto& accessPoint : selectedAccessPoints) {
-            xs[i] = accessPoint.second.first.x;
-            ys[i] = accessPoint.second.first.y;
-            i++;
+        for (int i = 0; i < degree; i++) {
+            xs[i] = pins[i].x;
+            ys[i] = pins[i].y;
         }
-        Tree flutetree = flute(degree, xs, ys, ACCURACY);
+        // branches stay valid until the next flute() call of this thread
+        const Branch* branches = fluteCache ? fluteCache->getTree(degree, xs, ys) : flute(degree, xs, ys, ACCURACY).branch;
         const int numBranches = degree + degree - 2;
         vector<utils::PointT<int>> steinerPoints;
         steinerPoints.reserve(numBranches);
         vector<vector<int>> adjacentList(numBranches);
         for (int branchIndex = 0; branchIndex < numBranches; branchIndex++) {
-            const Branch& branch = flutetree.branch[branchIndex];
+            const Branch& branch = branches[branchIndex];
             steinerPoints.emplace_back(branch.x, branch.y);
             if (branchIndex == branch.n)
                 continue;
             adjacentList[branchIndex].push_back(branch.n);
             adjacentList[branch.n].push_back(branchIndex);
         }
-        std::function<void(std::shared_ptr<SteinerTreeNode>&, int, int)> constructTree = [&](
-                                                                                             std::shared_ptr<SteinerTreeNode>& parent, int prevIndex, int curIndex) {
-            std::shared_ptr<SteinerTreeNode> current = std::make_shared<SteinerTreeNode>(steinerPoints[curIndex]);
-            if (parent != nullptr && parent->x == current->x && parent->y == current->y) {
+        // Emits the tree in preorder; a point coinciding with its parent is merged into the parent
+        tree.reserve(numBranches);
+        std::function<void(int, int, int)> constructTree = [&](int parent, int prevIndex, int curIndex) {
+            if (parent != -1 && tree[parent].x == steinerPoints[curIndex].x && tree[parent].y == steinerPoints[curIndex].y) {
                 for (int nextIndex : adjacentList[curIndex]) {
                     if (nextIndex == prevIndex)
                         continue;
@@ -53,23 +82,20 @@ void PatternRoute::constructSteinerTree() {
                 }
                 return;
             }
+            // Set fixed layer interval
+            SteinerPoint point(steinerPoints[curIndex]);
+            auto accessPoint = selectedAccessPoints.find(gridGraph.hashCell(point.x, point.y));
+            if (accessPoint != selectedAccessPoints.end()) {
+                point.fixedLayers = accessPoint->second.second;
+            }
+            const int current = tree.addNode(point, parent);
             // Build subtree
             for (int nextIndex : adjacentList[curIndex]) {
                 if (nextIndex == prevIndex)
                     continue;
                 constructTree(current, curIndex, nextIndex);
             }
-            // Set fixed layer interval
-            uint64_t hash = gridGraph.hashCell(current->x, current->y);
-            if (selectedAccessPoints.find(hash) != selectedAccessPoints.end()) {
-                current->fixedLayers = selectedAccessPoints[hash].second;
-            }
-            // Connect current to parent
-            if (parent == nullptr) {
-                parent = current;
-            } else {
-                parent->children.emplace_back(current);
-            }
+            tree.closeNode(current);
         };
         // Pick a root having degree 1
         int root = 0;
@@ -91,213 +117,226 @@ void PatternRoute::constructSteinerTree() {
                 break;
             }
         }
-        constructTree(steinerTree, -1, root);
+        constructTree(-1, -1, root);
     }
+    return true;
 }
 
 void PatternRoute::constructRoutingDAG() {
-    std::function<void(std::shared_ptr<PatternRoutingNode>&, std::shared_ptr<SteinerTreeNode>&)> constructDag = [&](
-                                                                                                                    std::shared_ptr<PatternRoutingNode>& dstNode, std::shared_ptr<SteinerTreeNode>& steiner) {
-        std::shared_ptr<PatternRoutingNode> current = std::make_shared<PatternRoutingNode>(
-            *steiner, steiner->fixedLayers, numDagNodes++);
-        for (auto steinerChild : steiner->children) {
-            constructDag(current, steinerChild);
-        }
-        if (dstNode == nullptr) {
-            dstNode = current;
-        } else {
-            dstNode->children.emplace_back(current);
-            constructPaths(dstNode, current);
-        }
+    std::function<int(int)> constructDag = [&](int steiner) {
+        const int current = dag.addNode((*steinerTree)[steiner], (*steinerTree)[steiner].fixedLayers);
+        steinerTree->forEachChild(steiner, [&](int steinerChild) {
+            const int child = constructDag(steinerChild);
+            dag.addChild(current, child);
+            constructPaths(current, child);
+        });
+        return current;
     };
-    constructDag(routingDag, steinerTree);
+    routingDag = constructDag(0);
 }
 
 void PatternRoute::extractNet(std::vector<std::pair<Point, Point> >& extracted_nets, int x_bound, int y_bound){
-    std::function<void(const std::shared_ptr<PatternRoutingNode>&)> preorder = [&](const std::shared_ptr<PatternRoutingNode>& node) {
-        if (node == nullptr)
+    std::function<void(int)> preorder = [&](int nodeIndex) {
+        if (nodeIndex == -1)
             return;
         
         // Do whatever you want to do with the current node here
-        for (const auto &child : node->children) {
-            /*for testing*/
-            // if((node->fixedLayers.high == 2147483647 && child->fixedLayers.low == 2147483647)||
-            //     (node->fixedLayers.high == 2147483647 && child->fixedLayers.low == -2147483648)||
-            //     (node->fixedLayers.high == -2147483648 && child->fixedLayers.low == 2147483647)||
-            //     (node->fixedLayers.high == -2147483648 && child->fixedLayers.low == -2147483648)
-            // ){
-            //     cout << net.getName() << endl;
-            // }
-            if(node->x <= x_bound && node->y <= y_bound &&
-                child->x <= x_bound && child->y <= y_bound // the 2-pin net completely falls in the region
+        dag.forEachChild(nodeIndex, [&](int childIndex) {
+            const PatternRoutingNode& node = dag.nodes[nodeIndex];
+            const PatternRoutingNode& child = dag.nodes[childIndex];
+            if(node.x <= x_bound && node.y <= y_bound &&
+                child.x <= x_bound && child.y <= y_bound // the 2-pin net completely falls in the region
             ){
                 // the layer is still undefined
-                // cout << "Node: " << node->x << " " << node->y << " " << node->fixedLayers.low << " " << node->fixedLayers.high << '\n';
-                int node_layer = (node->fixedLayers.low >= 0) ? node->fixedLayers.low : 0;
-                int child_layer = (child->fixedLayers.low >= 0) ? child->fixedLayers.low : 0;
-                extracted_nets.push_back(std::make_pair(Point(0, 0, node_layer, node->x, node->y), Point(0, 0, child_layer, child->x, child->y)));
+                int node_layer = (node.fixedLayers.low >= 0) ? node.fixedLayers.low : 0;
+                int child_layer = (child.fixedLayers.low >= 0) ? child.fixedLayers.low : 0;
+                extracted_nets.push_back(std::make_pair(Point(0, 0, node_layer, node.x, node.y), Point(0, 0, child_layer, child.x, child.y)));
             }
-            preorder(child);
-        }
+            preorder(childIndex);
+        });
     };
 
     // Call preorderTraversal with routingDag
     preorder(routingDag);
 }
 
-void PatternRoute::constructPaths(std::shared_ptr<PatternRoutingNode>& start, std::shared_ptr<PatternRoutingNode>& end, int childIndex) {
-    if (childIndex == -1) {
-        childIndex = start->paths.size();
-        start->paths.emplace_back();
+void PatternRoute::constructPaths(int start, int end, int childIndex) {
+    const int group = childIndex == -1 ? dag.addPathGroup(start) : dag.getPathGroup(start, childIndex);
+    // Copies: adding nodes may move the arena
+    const utils::PointT<int> startPoint = dag.nodes[start];
+    const utils::PointT<int> endPoint = dag.nodes[end];
+    if (startPoint.x == endPoint.x || startPoint.y == endPoint.y) {
+        dag.addPath(group, end);
+        return;
     }
-    vector<std::shared_ptr<PatternRoutingNode>>& childPaths = start->paths[childIndex];
-    if (start->x == end->x || start->y == end->y) {
-        childPaths.push_back(end);
-    } else {
-        // for (int pathIndex = 0; pathIndex <= 1; pathIndex++) {  // two paths of different L-shape
-        //     utils::PointT<int> midPoint = pathIndex ? utils::PointT<int>(start->x, end->y) : utils::PointT<int>(end->x, start->y);
-        //     std::shared_ptr<PatternRoutingNode> mid = std::make_shared<PatternRoutingNode>(midPoint, numDagNodes++, true);
-        //     mid->paths = {{end}};
-        //     childPaths.push_back(mid);
-        // }
+    // Path from start through the given bends to end; the bends are optional nodes with a single path each
+    auto addPattern = [&](std::initializer_list<utils::PointT<int>> bends) {
+        int next = end;
+        for (auto bend = std::rbegin(bends); bend != std::rend(bends); ++bend) {
+            const int mid = dag.addNode(*bend, true);
+            dag.addPath(dag.addPathGroup(mid), next);
+            next = mid;
+        }
+        dag.addPath(group, next);
+    };
 
+    const bool morePatterns = parameters.pattern_l_shapes || parameters.pattern_z_shapes || parameters.pattern_staircases;
+    if (!morePatterns || dag.nodes.size() >= parameters.pattern_max_dag_nodes) {
         // Add only one L-shape path (Alan 0530)
-        srand(3);
-        int pathIndex = rand() % 2;
-        utils::PointT<int> midPoint = pathIndex ? utils::PointT<int>(start->x, end->y) : utils::PointT<int>(end->x, start->y);
-        std::shared_ptr<PatternRoutingNode> mid = std::make_shared<PatternRoutingNode>(midPoint, numDagNodes++, true);
-        mid->paths = {{end}};
-        childPaths.push_back(mid);
-
-        // Add Z-shape paths
-        bool isZShape = false;
-        // if(start->x == 0 || start->x == gridGraph.getSize(0) - 1 || end->x == 0 || end->x == gridGraph.getSize(0) - 1) {
-        //     isZShape = true;
-        // }
-        if (isZShape) {
-            for (int zPathIndex = 0; zPathIndex <= 1; zPathIndex++) {
-                utils::PointT<int> firstMidPoint, secondMidPoint;
-
-                if (zPathIndex == 0) {
-                    // First Z-shape pattern
-                    firstMidPoint = utils::PointT<int>((start->x + end->x) / 2, start->y);
-                    secondMidPoint = utils::PointT<int>((start->x + end->x) / 2, end->y);
-                } else {
-                    // Second Z-shape pattern
-                    firstMidPoint = utils::PointT<int>(start->x, (start->y + end->y) / 2);
-                    secondMidPoint = utils::PointT<int>(end->x, (start->y + end->y) / 2);
-                }
-
-                std::shared_ptr<PatternRoutingNode> firstMid = std::make_shared<PatternRoutingNode>(firstMidPoint, numDagNodes++, true);
-                std::shared_ptr<PatternRoutingNode> secondMid = std::make_shared<PatternRoutingNode>(secondMidPoint, numDagNodes++, true);
-                secondMid->paths = {{end}};
-                firstMid->paths = {{secondMid}};
+        // srand(3) + rand() picks the same L-shape for every net; done once, as concurrent rand() calls interleave
+        static const int pathIndex = [] {
+            srand(3);
+            return rand() % 2;
+        }();
+        addPattern({pathIndex ? utils::PointT<int>(startPoint.x, endPoint.y) : utils::PointT<int>(endPoint.x, startPoint.y)});
+        return;
+    }
 
-                childPaths.push_back(firstMid);
-            }
+    // Both L-shapes, which are also the base of the detours in stage 2
+    addPattern({utils::PointT<int>(endPoint.x, startPoint.y)});
+    addPattern({utils::PointT<int>(startPoint.x, endPoint.y)});
+    // Bend positions strictly between the ends: all of them, or pattern_max_bends evenly spaced ones
+    auto sampleBends = [&](int low, int high, vector<int>& positions) {
+        if (low > high)
+            std::swap(low, high);
+        const int numPositions = high - low - 1;
+        const int numSamples = std::min(numPositions, parameters.pattern_max_bends);
+        positions.clear();
+        for (int i = 0; i < numSamples; i++)
+            positions.push_back(numSamples == numPositions ? low + 1 + i : low + (i + 1) * (high - low) / (numSamples + 1));
+    };
+    vector<int> xs, ys;
+    sampleBends(startPoint.x, endPoint.x, xs);
+    sampleBends(startPoint.y, endPoint.y, ys);
+    if (parameters.pattern_z_shapes) {
+        for (int x : xs) addPattern({utils::PointT<int>(x, startPoint.y), utils::PointT<int>(x, endPoint.y)});
+        for (int y : ys) addPattern({utils::PointT<int>(startPoint.x, y), utils::PointT<int>(endPoint.x, y)});
+    }
+    if (parameters.pattern_staircases) {
+        // Monotonic paths with three bends, one step of the staircase per sampled (x, y) pair
+        for (int i = 0; i < std::min(xs.size(), ys.size()); i++) {
+            const int x = xs[i], y = ys[i];
+            addPattern({utils::PointT<int>(x, startPoint.y), utils::PointT<int>(x, y), utils::PointT<int>(endPoint.x, y)});
+            addPattern({utils::PointT<int>(startPoint.x, y), utils::PointT<int>(x, y), utils::PointT<int>(x, endPoint.y)});
         }
     }
 }
 
 void PatternRoute::constructDetours(GridGraphView<bool>& congestionView) {
     struct ScaffoldNode {
-        std::shared_ptr<PatternRoutingNode> node;
-        vector<std::shared_ptr<ScaffoldNode>> children;
-        ScaffoldNode(std::shared_ptr<PatternRoutingNode> n)
+        int node;  // -1 for the virtual root above the DAG root
+        vector<int> children;
+        ScaffoldNode(int n)
             : node(n) {}
     };
+    vector<ScaffoldNode> scaffoldPool;
+    auto newScaffold = [&](int node) {
+        scaffoldPool.emplace_back(node);
+        return (int)scaffoldPool.size() - 1;
+    };
+    auto point = [&](int node) { return (utils::PointT<int>)dag.nodes[node]; };
 
-    vector<vector<std::shared_ptr<ScaffoldNode>>> scaffolds(2);
-    vector<vector<std::shared_ptr<ScaffoldNode>>> scaffoldNodes(
-        2, vector<std::shared_ptr<ScaffoldNode>>(numDagNodes, nullptr));  // direction -> numDagNodes -> scaffold node
+    const int numDagNodes = getNumDagNodes();
+    vector<vector<int>> scaffolds(2);
+    vector<vector<int>> scaffoldNodes(2, vector<int>(numDagNodes, -1));  // direction -> numDagNodes -> scaffold node
     vector<bool> visited(numDagNodes, false);
 
-    std::function<void(std::shared_ptr<PatternRoutingNode>)> buildScaffolds =
-        [&](std::shared_ptr<PatternRoutingNode> node) {
-            if (visited[node->index])
+    std::function<void(int)> buildScaffolds =
+        [&](int node) {
+            if (visited[node])
                 return;
-            visited[node->index] = true;
-
-            if (node->optional) {
-                assert(node->paths.size() == 1 && node->paths[0].size() == 1 && !node->paths[0][0]->optional);
-                auto& path = node->paths[0][0];
+            visited[node] = true;
+
+            if (dag.nodes[node].optional) {
+                const int group = dag.nodes[node].firstPathGroup;
+                assert(dag.nodes[node].numPathGroups == 1 && dag.pathGroups[group].firstPath == dag.pathGroups[group].lastPath);
+                const int path = dag.links[dag.pathGroups[group].firstPath].node;
+                if (dag.nodes[path].optional)
+                    return;  // Z-shape or staircase: detours start from the L-shapes towards the same child
                 buildScaffolds(path);
-                unsigned direction = (node->y == path->y ? 0 : 1);
-                if (!scaffoldNodes[direction][path->index] && congestionView.check(*node, *path)) {
-                    scaffoldNodes[direction][path->index] = std::make_shared<ScaffoldNode>(path);
+                unsigned direction = (dag.nodes[node].y == dag.nodes[path].y ? 0 : 1);
+                if (scaffoldNodes[direction][path] == -1 && congestionView.check(point(node), point(path))) {
+                    scaffoldNodes[direction][path] = newScaffold(path);
                 }
             } else {
-                for (auto& childPaths : node->paths) {
-                    for (auto& path : childPaths) {
+                dag.forEachPathGroup(node, [&](int group) {
+                    dag.forEachPath(group, [&](int path) {
                         buildScaffolds(path);
-                        unsigned direction = (node->y == path->y ? 0 : 1);
-                        if (path->optional) {
-                            if (!scaffoldNodes[direction][node->index] && congestionView.check(*node, *path)) {
-                                scaffoldNodes[direction][node->index] = std::make_shared<ScaffoldNode>(node);
+                        unsigned direction = (dag.nodes[node].y == dag.nodes[path].y ? 0 : 1);
+                        if (dag.nodes[path].optional) {
+                            const int pathGroup = dag.nodes[path].firstPathGroup;
+                            if (dag.nodes[dag.links[dag.pathGroups[pathGroup].firstPath].node].optional)
+                                return;
+                            if (scaffoldNodes[direction][node] == -1 && congestionView.check(point(node), point(path))) {
+                                scaffoldNodes[direction][node] = newScaffold(node);
                             }
                         } else {
-                            if (congestionView.check(*node, *path)) {
-                                if (!scaffoldNodes[direction][node->index]) {
-                                    scaffoldNodes[direction][node->index] = std::make_shared<ScaffoldNode>(node);
+                            if (congestionView.check(point(node), point(path))) {
+                                if (scaffoldNodes[direction][node] == -1) {
+                                    scaffoldNodes[direction][node] = newScaffold(node);
                                 }
-                                if (!scaffoldNodes[direction][path->index]) {
-                                    scaffoldNodes[direction][node->index]->children.emplace_back(std::make_shared<ScaffoldNode>(path));
+                                if (scaffoldNodes[direction][path] == -1) {
+                                    const int scaffold = newScaffold(path);
+                                    scaffoldPool[scaffoldNodes[direction][node]].children.emplace_back(scaffold);
                                 } else {
-                                    scaffoldNodes[direction][node->index]->children.emplace_back(scaffoldNodes[direction][path->index]);
-                                    scaffoldNodes[direction][path->index] = nullptr;
+                                    scaffoldPool[scaffoldNodes[direction][node]].children.emplace_back(scaffoldNodes[direction][path]);
+                                    scaffoldNodes[direction][path] = -1;
                                 }
                             }
                         }
-                    }
-                    for (auto& child : node->children) {
+                    });
+                    dag.forEachChild(node, [&](int child) {
                         for (unsigned direction = 0; direction < 2; direction++) {
-                            if (scaffoldNodes[direction][child->index]) {
-                                scaffolds[direction].emplace_back(std::make_shared<ScaffoldNode>(node));
-                                scaffolds[direction].back()->children.emplace_back(scaffoldNodes[direction][child->index]);
-                                scaffoldNodes[direction][child->index] = nullptr;
+                            if (scaffoldNodes[direction][child] != -1) {
+                                const int scaffold = newScaffold(node);
+                                scaffolds[direction].emplace_back(scaffold);
+                                scaffoldPool[scaffold].children.emplace_back(scaffoldNodes[direction][child]);
+                                scaffoldNodes[direction][child] = -1;
                             }
                         }
-                    }
-                }
+                    });
+                });
             }
         };
 
     buildScaffolds(routingDag);
     for (unsigned direction = 0; direction < 2; direction++) {
-        if (scaffoldNodes[direction][routingDag->index]) {
-            scaffolds[direction].emplace_back(std::make_shared<ScaffoldNode>(nullptr));
-            scaffolds[direction].back()->children.emplace_back(scaffoldNodes[direction][routingDag->index]);
+        if (scaffoldNodes[direction][routingDag] != -1) {
+            const int scaffold = newScaffold(-1);
+            scaffolds[direction].emplace_back(scaffold);
+            scaffoldPool[scaffold].children.emplace_back(scaffoldNodes[direction][routingDag]);
         }
     }
 
-    std::function<void(std::shared_ptr<ScaffoldNode>, utils::IntervalT<int>&, vector<int>&, unsigned, bool)> getTrunkAndStems =
-        [&](std::shared_ptr<ScaffoldNode> scaffoldNode, utils::IntervalT<int>& trunk, vector<int>& stems, unsigned direction, bool starting) {
+    std::function<void(int, utils::IntervalT<int>&, vector<int>&, unsigned, bool)> getTrunkAndStems =
+        [&](int scaffoldNode, utils::IntervalT<int>& trunk, vector<int>& stems, unsigned direction, bool starting) {
+            const int node = scaffoldPool[scaffoldNode].node;
             if (starting) {
-                if (scaffoldNode->node) {
-                    stems.emplace_back((*scaffoldNode->node)[1 - direction]);
-                    trunk.Update((*scaffoldNode->node)[direction]);
+                if (node != -1) {
+                    stems.emplace_back(point(node)[1 - direction]);
+                    trunk.Update(point(node)[direction]);
                 }
-                for (auto& scaffoldChild : scaffoldNode->children)
+                for (int scaffoldChild : scaffoldPool[scaffoldNode].children)
                     getTrunkAndStems(scaffoldChild, trunk, stems, direction, false);
             } else {
-                trunk.Update((*scaffoldNode->node)[direction]);
-                if (scaffoldNode->node->fixedLayers.IsValid()) {
-                    stems.emplace_back((*scaffoldNode->node)[1 - direction]);
+                trunk.Update(point(node)[direction]);
+                if (dag.nodes[node].fixedLayers.IsValid()) {
+                    stems.emplace_back(point(node)[1 - direction]);
                 }
-                for (auto& treeChild : scaffoldNode->node->children) {
+                dag.forEachChild(node, [&](int treeChild) {
                     bool scaffolded = false;
-                    for (auto& scaffoldChild : scaffoldNode->children) {
-                        if (treeChild == scaffoldChild->node) {
+                    for (int scaffoldChild : scaffoldPool[scaffoldNode].children) {
+                        if (treeChild == scaffoldPool[scaffoldChild].node) {
                             getTrunkAndStems(scaffoldChild, trunk, stems, direction, false);
                             scaffolded = true;
                             break;
                         }
                     }
                     if (!scaffolded) {
-                        stems.emplace_back((*treeChild)[1 - direction]);
-                        trunk.Update((*treeChild)[direction]);
+                        stems.emplace_back(point(treeChild)[1 - direction]);
+                        trunk.Update(point(treeChild)[direction]);
                     }
-                }
+                });
             }
         };
 
@@ -308,62 +347,52 @@ void PatternRoute::constructDetours(GridGraphView<bool>& congestionView) {
         return length;
     };
 
-    std::function<std::shared_ptr<PatternRoutingNode>(std::shared_ptr<ScaffoldNode>, unsigned, int)> buildDetour =
-        [&](std::shared_ptr<ScaffoldNode> scaffoldNode, unsigned direction, int shiftAmount) {
-            std::shared_ptr<PatternRoutingNode> treeNode = scaffoldNode->node;
-            if (treeNode->fixedLayers.IsValid()) {
-                std::shared_ptr<PatternRoutingNode> dupTreeNode =
-                    std::make_shared<PatternRoutingNode>((utils::PointT<int>)*treeNode, treeNode->fixedLayers, numDagNodes++);
-                std::shared_ptr<PatternRoutingNode> shiftedTreeNode =
-                    std::make_shared<PatternRoutingNode>((utils::PointT<int>)*treeNode, numDagNodes++);
-                (*shiftedTreeNode)[1 - direction] += shiftAmount;
-                constructPaths(shiftedTreeNode, dupTreeNode);
-                for (auto& treeChild : treeNode->children) {
-                    bool built = false;
-                    for (auto& scaffoldChild : scaffoldNode->children) {
-                        if (treeChild == scaffoldChild->node) {
-                            auto shiftedChildTreeNode = buildDetour(scaffoldChild, direction, shiftAmount);
-                            constructPaths(shiftedTreeNode, shiftedChildTreeNode);
-                            built = true;
-                            break;
-                        }
-                    }
-                    if (!built) {
-                        constructPaths(shiftedTreeNode, treeChild);
-                    }
+    // Connects shiftedTreeNode to the children of treeNode, shifting the scaffolded ones as well
+    std::function<int(int, unsigned, int)> buildDetour;
+    auto connectShiftedChildren = [&](int scaffoldNode, int treeNode, int shiftedTreeNode, unsigned direction, int shiftAmount) {
+        dag.forEachChild(treeNode, [&](int treeChild) {
+            bool built = false;
+            for (int scaffoldChild : scaffoldPool[scaffoldNode].children) {
+                if (treeChild == scaffoldPool[scaffoldChild].node) {
+                    int shiftedChildTreeNode = buildDetour(scaffoldChild, direction, shiftAmount);
+                    constructPaths(shiftedTreeNode, shiftedChildTreeNode);
+                    built = true;
+                    break;
                 }
+            }
+            if (!built) {
+                constructPaths(shiftedTreeNode, treeChild);
+            }
+        });
+    };
+    buildDetour =
+        [&](int scaffoldNode, unsigned direction, int shiftAmount) {
+            const int treeNode = scaffoldPool[scaffoldNode].node;
+            const utils::IntervalT<int> fixedLayers = dag.nodes[treeNode].fixedLayers;
+            if (fixedLayers.IsValid()) {
+                const int dupTreeNode = dag.addNode(point(treeNode), fixedLayers);
+                const int shiftedTreeNode = dag.addNode(point(treeNode));
+                dag.nodes[shiftedTreeNode][1 - direction] += shiftAmount;
+                constructPaths(shiftedTreeNode, dupTreeNode);
+                connectShiftedChildren(scaffoldNode, treeNode, shiftedTreeNode, direction, shiftAmount);
                 return shiftedTreeNode;
             } else {
-                std::shared_ptr<PatternRoutingNode> shiftedTreeNode =
-                    std::make_shared<PatternRoutingNode>((utils::PointT<int>)*treeNode, numDagNodes++);
-                (*shiftedTreeNode)[1 - direction] += shiftAmount;
-                for (auto& treeChild : treeNode->children) {
-                    bool built = false;
-                    for (auto& scaffoldChild : scaffoldNode->children) {
-                        if (treeChild == scaffoldChild->node) {
-                            auto shiftedChildTreeNode = buildDetour(scaffoldChild, direction, shiftAmount);
-                            constructPaths(shiftedTreeNode, shiftedChildTreeNode);
-                            built = true;
-                            break;
-                        }
-                    }
-                    if (!built) {
-                        constructPaths(shiftedTreeNode, treeChild);
-                    }
-                }
+                const int shiftedTreeNode = dag.addNode(point(treeNode));
+                dag.nodes[shiftedTreeNode][1 - direction] += shiftAmount;
+                connectShiftedChildren(scaffoldNode, treeNode, shiftedTreeNode, direction, shiftAmount);
                 return shiftedTreeNode;
             }
         };
 
     for (unsigned direction = 0; direction < 2; direction++) {
-        for (std::shared_ptr<ScaffoldNode> scaffold : scaffolds[direction]) {
-            assert(scaffold->children.size() == 1);
+        for (int scaffold : scaffolds[direction]) {
+            assert(scaffoldPool[scaffold].children.size() == 1);
 
             utils::IntervalT<int> trunk;
             vector<int> stems;
             getTrunkAndStems(scaffold, trunk, stems, direction, true);
             std::sort(stems.begin(), stems.end());
-            int trunkPos = (*scaffold->children[0]->node)[1 - direction];
+            int trunkPos = point(scaffoldPool[scaffoldPool[scaffold].children[0]].node)[1 - direction];
             int originalLength = getTotalStemLength(stems, trunkPos);
             utils::IntervalT<int> shiftInterval(trunkPos);
             int maxLengthIncrease = trunk.range() * parameters.max_detour_ratio;
@@ -381,46 +410,34 @@ void PatternRoute::constructDetours(GridGraphView<bool>& congestionView) {
                 int shiftAmount = (pos - trunkPos);
                 if (shiftAmount == 0)
                     continue;
-                if (scaffold->node) {
-                    auto& scaffoldChild = scaffold->children[0];
-                    if ((*scaffoldChild->node)[1 - direction] + shiftAmount < 0 ||
-                        (*scaffoldChild->node)[1 - direction] + shiftAmount >= gridGraph.getSize(1 - direction)) {
+                const int scaffoldTreeNode = scaffoldPool[scaffold].node;
+                if (scaffoldTreeNode != -1) {
+                    const int scaffoldChild = scaffoldPool[scaffold].children[0];
+                    const int scaffoldChildNode = scaffoldPool[scaffoldChild].node;
+                    if (point(scaffoldChildNode)[1 - direction] + shiftAmount < 0 ||
+                        point(scaffoldChildNode)[1 - direction] + shiftAmount >= gridGraph.getSize(1 - direction)) {
                         continue;
                     }
-                    for (int childIndex = 0; childIndex < scaffold->node->children.size(); childIndex++) {
-                        auto& treeChild = scaffold->node->children[childIndex];
-                        if (treeChild == scaffoldChild->node) {
-                            std::shared_ptr<PatternRoutingNode> shiftedChild = buildDetour(scaffoldChild, direction, shiftAmount);
-                            constructPaths(scaffold->node, shiftedChild, childIndex);
+                    int childIndex = 0;
+                    dag.forEachChild(scaffoldTreeNode, [&](int treeChild) {
+                        if (treeChild == scaffoldChildNode) {
+                            int shiftedChild = buildDetour(scaffoldChild, direction, shiftAmount);
+                            constructPaths(scaffoldTreeNode, shiftedChild, childIndex);
                         }
-                    }
+                        childIndex++;
+                    });
                 } else {
-                    std::shared_ptr<ScaffoldNode> scaffoldNode = scaffold->children[0];
-                    auto treeNode = scaffoldNode->node;
-                    if (treeNode->children.size() == 1) {
-                        if ((*treeNode)[1 - direction] + shiftAmount < 0 ||
-                            (*treeNode)[1 - direction] + shiftAmount >= gridGraph.getSize(1 - direction)) {
+                    const int scaffoldNode = scaffoldPool[scaffold].children[0];
+                    const int treeNode = scaffoldPool[scaffoldNode].node;
+                    if (dag.nodes[treeNode].numChildren == 1) {
+                        if (point(treeNode)[1 - direction] + shiftAmount < 0 ||
+                            point(treeNode)[1 - direction] + shiftAmount >= gridGraph.getSize(1 - direction)) {
                             continue;
                         }
-                        std::shared_ptr<PatternRoutingNode> shiftedTreeNode =
-                            std::make_shared<PatternRoutingNode>((utils::PointT<int>)*treeNode, numDagNodes++);
-                        (*shiftedTreeNode)[1 - direction] += shiftAmount;
+                        const int shiftedTreeNode = dag.addNode(point(treeNode));
+                        dag.nodes[shiftedTreeNode][1 - direction] += shiftAmount;
                         constructPaths(treeNode, shiftedTreeNode, 0);
-                        for (auto& treeChild : treeNode->children) {
-                            bool built = false;
-                            for (auto& scaffoldChild : scaffoldNode->children) {
-                                if (treeChild == scaffoldChild->node) {
-                                    auto shiftedChildTreeNode = buildDetour(scaffoldChild, direction, shiftAmount);
-                                    constructPaths(shiftedTreeNode, shiftedChildTreeNode);
-                                    built = true;
-                                    break;
-                                }
-                            }
-                            if (!built) {
-                                constructPaths(shiftedTreeNode, treeChild);
-                            }
-                        }
-
+                        connectShiftedChildren(scaffoldNode, treeNode, shiftedTreeNode, direction, shiftAmount);
                     } else {
                         cout << "Warning: the root has not exactly one child." << '\n';
                     }
@@ -438,50 +455,60 @@ void PatternRoute::getAllAccessPoints() {
     }
 }
 
-void PatternRoute::pruneRoutingTree(std::shared_ptr<GRTreeNode>& node) {
-    if (node->children.size() == 0) {
+void PatternRoute::pruneRoutingTree(const GRTree& tree, GRTree& pruned) const {
+    pruned.clear();
+    pruned.reserve(tree.size());
+    // Layer of a node once pruned, -1 for a leaf to be removed
+    auto prunedLayer = [&](const int index) {
+        const GRTree::Node& node = tree[index];
+        if (node.numChildren > 0)
+            return node.layerIdx;
         // check if the node is an access point
         int maxlayer = -1;
         for (auto& accessPoint : allAccessPoints) {
-            if (accessPoint.x == node->x && accessPoint.y == node->y && accessPoint.layerIdx == node->layerIdx) {
-                return;
+            if (accessPoint.x == node.x && accessPoint.y == node.y && accessPoint.layerIdx == node.layerIdx) {
+                return node.layerIdx;
             }
-            if (accessPoint.x == node->x && accessPoint.y == node->y) {
-                // node->layerIdx = accessPoint.layerIdx;
-                // return;
+            if (accessPoint.x == node.x && accessPoint.y == node.y) {
                 maxlayer = max(accessPoint.layerIdx, maxlayer);
             }
         }
-        if (maxlayer != -1) {
-            node->layerIdx = maxlayer;
-            return;
+        return maxlayer;
+    };
+    // A child on the same point and layer as its parent is removed and its children move to the end of the
+    // children of the parent, from the last such child to the first
+    auto isSame = [&](const int index, const std::pair<int, int>& child) {
+        return tree[child.first].x == tree[index].x && tree[child.first].y == tree[index].y && child.second == tree[index].layerIdx;
+    };
+    std::function<void(int, int)> addChildren;
+    std::function<void(int, int, int)> addSubtree = [&](int index, int layerIndex, int parent) {
+        const int current = pruned.addNode(GRPoint(layerIndex, tree[index].x, tree[index].y), parent);
+        addChildren(index, current);
+        pruned.closeNode(current);
+    };
+    addChildren = [&](int index, int parent) {
+        vector<std::pair<int, int>> children;  // (child, pruned layer)
+        tree.forEachChild(index, [&](int child) { children.emplace_back(child, prunedLayer(child)); });
+        for (const auto& child : children) {
+            if (child.second != -1 && !isSame(index, child))
+                addSubtree(child.first, child.second, parent);
         }
-        // if not, remove the node
-        node = nullptr;
-        return;
-
-    } else {
-        for (int i = node->children.size() - 1; i >= 0; i--) {
-            pruneRoutingTree(node->children[i]);
-            bool same = (node->x == node->children[i]->x) && (node->y == node->children[i]->y) && (node->layerIdx == node->children[i]->layerIdx);
-
-            if (node->children[i] == nullptr) {
-                node->children.erase(node->children.begin() + i);
-            } else if (same) {  // remove the child and move its children to the parent
-                for (auto& child : node->children[i]->children) {
-                    node->children.push_back(child);
-                }
-                node->children.erase(node->children.begin() + i);
-            }
+        for (int i = (int)children.size() - 1; i >= 0; i--) {
+            if (isSame(index, children[i]))
+                addChildren(children[i].first, parent);
         }
-    }
+    };
+    if (!tree.empty() && prunedLayer(0) != -1)
+        addSubtree(0, prunedLayer(0), -1);
 }
 
 void PatternRoute::run() {
+    const size_t numLayers = gridGraph.getNumLayers();
+    dag.costs.resize(dag.nodes.size() * numLayers);
+    dag.bestPaths.resize(dag.pathGroups.size() * numLayers);
     calculateRoutingCosts(routingDag);
-    // net.setRoutingTree(getRoutingTree(routingDag));
-
-    std::shared_ptr<GRTreeNode> routingTree = getRoutingTree(routingDag);
+    GRTree routingTree;
+    getRoutingTree(routingTree, routingDag);
 
     // prune the tree
     getAllAccessPoints();
@@ -495,145 +522,304 @@ void PatternRoute::run() {
 
     // not pruning routing tree for mempool_cluster debugging
     if (!isDuplicate) {
-        pruneRoutingTree(routingTree);
+        GRTree prunedTree;
+        pruneRoutingTree(routingTree, prunedTree);
+        net.setRoutingTree(std::move(prunedTree));
+    } else {
+        net.setRoutingTree(std::move(routingTree));
     }
-    net.setRoutingTree(routingTree);
 }
 
-void PatternRoute::calculateRoutingCosts(std::shared_ptr<PatternRoutingNode>& node) {
-    if (node->costs.size() != 0)
+void PatternRoute::calculateRoutingCosts(int node) {
+    if (dag.nodes[node].costsReady)
         return;
-    vector<vector<std::pair<CostT, int>>> childCosts;  // childIndex -> layerIndex -> (cost, pathIndex)
+    dag.nodes[node].costsReady = true;
+    // Paths first, so that the scratch space below is not shared with the recursion
+    dag.forEachPathGroup(node, [&](int group) {
+        dag.forEachPath(group, [&](int path) { calculateRoutingCosts(path); });
+    });
+
+    const int numLayers = gridGraph.getNumLayers();
+    const utils::PointT<int> nodePoint = dag.nodes[node];
+    vector<int>& groups = dag.groupScratch;
+    groups.clear();
+    dag.forEachPathGroup(node, [&](int group) { groups.push_back(group); });
+    const int numChildren = groups.size();
+
     // Calculate child costs
-    if (node->paths.size() > 0)
-        childCosts.resize(node->paths.size());
-    for (int childIndex = 0; childIndex < node->paths.size(); childIndex++) {
-        auto& childPaths = node->paths[childIndex];
-        auto& costs = childCosts[childIndex];
-        costs.assign(gridGraph.getNumLayers(), {std::numeric_limits<CostT>::max(), -1});
-        for (int pathIndex = 0; pathIndex < childPaths.size(); pathIndex++) {
-            std::shared_ptr<PatternRoutingNode>& path = childPaths[pathIndex];
-            calculateRoutingCosts(path);
-            unsigned direction = node->x == path->x ? 1 : 0;
-            assert((*node)[1 - direction] == (*path)[1 - direction]);
-            for (int layerIndex = parameters.min_routing_layer; layerIndex < gridGraph.getNumLayers(); layerIndex++) {
+    vector<std::pair<CostT, int>>& childCosts = dag.childCostScratch;  // childIndex * numLayers + layerIndex -> (cost, path)
+    childCosts.assign(numChildren * numLayers, {std::numeric_limits<CostT>::max(), -1});
+    for (int childIndex = 0; childIndex < numChildren; childIndex++) {
+        std::pair<CostT, int>* costs = childCosts.data() + childIndex * numLayers;
+        dag.forEachPath(groups[childIndex], [&](int path) {
+            const utils::PointT<int> pathPoint = dag.nodes[path];
+            const CostT* pathCosts = dag.costs.data() + (size_t)path * numLayers;
+            unsigned direction = nodePoint.x == pathPoint.x ? 1 : 0;
+            assert(nodePoint[1 - direction] == pathPoint[1 - direction]);
+            for (int layerIndex = parameters.min_routing_layer; layerIndex < numLayers; layerIndex++) {
                 if (gridGraph.getLayerDirection(layerIndex) != direction)
                     continue;
-                CostT cost = path->costs[layerIndex] + gridGraph.getWireCost(layerIndex, *node, *path);
+                CostT cost = pathCosts[layerIndex] + gridGraph.getWireCost(layerIndex, nodePoint, pathPoint);
                 assert(cost >= 0);
                 if (cost < costs[layerIndex].first)
-                    costs[layerIndex] = std::make_pair(cost, pathIndex);
+                    costs[layerIndex] = std::make_pair(cost, path);
             }
-        }
+        });
     }
 
-    node->costs.assign(gridGraph.getNumLayers(), std::numeric_limits<CostT>::max());
-    node->bestPaths.resize(gridGraph.getNumLayers());
-    if (node->paths.size() > 0) {
-        for (int layerIndex = 1; layerIndex < gridGraph.getNumLayers(); layerIndex++) {
-            node->bestPaths[layerIndex].assign(node->paths.size(), {-1, -1});
+    // Calculate the partial sum of the via costs
+    vector<CostT>& viaCosts = dag.viaCostScratch;
+    viaCosts.resize(numLayers);
+    gridGraph.getViaCosts(nodePoint, viaCosts.data());
+    utils::IntervalT<int> fixedLayers = dag.nodes[node].fixedLayers;
+    fixedLayers.low = min(fixedLayers.low, numLayers - 1);
+    fixedLayers.high = max(fixedLayers.high, parameters.min_routing_layer);
+
+    if (!parameters.linear_layer_dp || parameters.check_layer_dp)
+        assignLayersQuadratic(node, fixedLayers);
+    if (parameters.linear_layer_dp && parameters.check_layer_dp) {
+        // Reports where the linear assignment picks other costs, paths or layers
+        const CostT* nodeCosts = dag.costs.data() + (size_t)node * numLayers;
+        vector<CostT>& referenceCosts = dag.referenceCostScratch;
+        vector<std::pair<int, int>>& referencePaths = dag.referencePathScratch;
+        referenceCosts.assign(nodeCosts, nodeCosts + numLayers);
+        referencePaths.clear();
+        for (int group : groups)
+            referencePaths.insert(referencePaths.end(), dag.bestPaths.begin() + (size_t)group * numLayers, dag.bestPaths.begin() + (size_t)(group + 1) * numLayers);
+        assignLayersLinear(node, fixedLayers);
+        for (int layerIndex = 0; layerIndex < numLayers; layerIndex++) {
+            bool same = nodeCosts[layerIndex] == referenceCosts[layerIndex];
+            for (int childIndex = 0; childIndex < numChildren; childIndex++)
+                same = same && dag.bestPaths[(size_t)groups[childIndex] * numLayers + layerIndex] == referencePaths[childIndex * numLayers + layerIndex];
+            if (!same) {
+                std::cerr << "[ERROR] Layer assignment of net " << net.getName() << " at " << nodePoint << " on layer " << layerIndex
+                          << " differs: cost " << nodeCosts[layerIndex] << " instead of " << referenceCosts[layerIndex] << std::endl;
+            }
         }
+    } else if (parameters.linear_layer_dp) {
+        assignLayersLinear(node, fixedLayers);
     }
-    // Calculate the partial sum of the via costs
-    vector<CostT> viaCosts(gridGraph.getNumLayers());
-    viaCosts[0] = 0;
-    for (int layerIndex = 1; layerIndex < gridGraph.getNumLayers(); layerIndex++) {
-        viaCosts[layerIndex] = viaCosts[layerIndex - 1] + gridGraph.getViaCost(layerIndex - 1, *node);
+}
+
+void PatternRoute::assignLayersQuadratic(int node, const utils::IntervalT<int>& fixedLayers) {
+    const int numLayers = gridGraph.getNumLayers();
+    const vector<int>& groups = dag.groupScratch;
+    const int numChildren = groups.size();
+    const vector<std::pair<CostT, int>>& childCosts = dag.childCostScratch;
+    const vector<CostT>& viaCosts = dag.viaCostScratch;
+    CostT* nodeCosts = dag.costs.data() + (size_t)node * numLayers;
+    std::fill(nodeCosts, nodeCosts + numLayers, std::numeric_limits<CostT>::max());
+    auto bestPathsOf = [&](int childIndex) { return dag.bestPaths.data() + (size_t)groups[childIndex] * numLayers; };
+    for (int childIndex = 0; childIndex < numChildren; childIndex++) {
+        std::fill(bestPathsOf(childIndex), bestPathsOf(childIndex) + numLayers, std::make_pair(-1, -1));
     }
-    utils::IntervalT<int> fixedLayers = node->fixedLayers;
-    fixedLayers.low = min(fixedLayers.low, static_cast<int>(gridGraph.getNumLayers()) - 1);
-    fixedLayers.high = max(fixedLayers.high, parameters.min_routing_layer);
 
+    vector<CostT>& minChildCosts = dag.minChildCostScratch;
+    vector<std::pair<int, int>>& bestPaths = dag.bestPathScratch;
     for (int lowLayerIndex = 0; lowLayerIndex <= fixedLayers.low; lowLayerIndex++) {
-        vector<CostT> minChildCosts;
-        vector<std::pair<int, int>> bestPaths;
-        if (node->paths.size() > 0) {
-            minChildCosts.assign(node->paths.size(), std::numeric_limits<CostT>::max());
-            bestPaths.assign(node->paths.size(), {-1, -1});
-        }
-        for (int layerIndex = lowLayerIndex; layerIndex < gridGraph.getNumLayers(); layerIndex++) {
-            for (int childIndex = 0; childIndex < node->paths.size(); childIndex++) {
-                if (childCosts[childIndex][layerIndex].first < minChildCosts[childIndex]) {
-                    minChildCosts[childIndex] = childCosts[childIndex][layerIndex].first;
-                    bestPaths[childIndex] = std::make_pair(childCosts[childIndex][layerIndex].second, layerIndex);
+        minChildCosts.assign(numChildren, std::numeric_limits<CostT>::max());
+        bestPaths.assign(numChildren, {-1, -1});
+        for (int layerIndex = lowLayerIndex; layerIndex < numLayers; layerIndex++) {
+            for (int childIndex = 0; childIndex < numChildren; childIndex++) {
+                const std::pair<CostT, int>& childCost = childCosts[childIndex * numLayers + layerIndex];
+                if (childCost.first < minChildCosts[childIndex]) {
+                    minChildCosts[childIndex] = childCost.first;
+                    bestPaths[childIndex] = std::make_pair(childCost.second, layerIndex);
                 }
             }
             if (layerIndex >= fixedLayers.high) {
                 CostT cost = viaCosts[layerIndex] - viaCosts[lowLayerIndex];
-                // CostT cost = 0;
-                // if (layerIndex - lowLayerIndex >= 3) {
-                //     cost = viaCosts[layerIndex] - viaCosts[lowLayerIndex]; // - 2*parameters.UnitViaDemand;
-                // }
-                // CostT cost = viaCosts[layerIndex] - viaCosts[fixedLayers.high];
                 assert(cost >= 0);
                 for (CostT childCost : minChildCosts)
                     cost += childCost;
                 assert(cost >= 0);
-                if (cost < node->costs[layerIndex]) {
-                    node->costs[layerIndex] = cost;
-                    node->bestPaths[layerIndex] = bestPaths;
+                if (cost < nodeCosts[layerIndex]) {
+                    nodeCosts[layerIndex] = cost;
+                    for (int childIndex = 0; childIndex < numChildren; childIndex++)
+                        bestPathsOf(childIndex)[layerIndex] = bestPaths[childIndex];
                 }
             }
         }
-        for (int layerIndex = gridGraph.getNumLayers() - 2; layerIndex >= lowLayerIndex; layerIndex--) {
-            if (node->costs[layerIndex + 1] < node->costs[layerIndex]) {
-                node->costs[layerIndex] = node->costs[layerIndex + 1];
-                node->bestPaths[layerIndex] = node->bestPaths[layerIndex + 1];
+        for (int layerIndex = numLayers - 2; layerIndex >= lowLayerIndex; layerIndex--) {
+            if (nodeCosts[layerIndex + 1] < nodeCosts[layerIndex]) {
+                nodeCosts[layerIndex] = nodeCosts[layerIndex + 1];
+                for (int childIndex = 0; childIndex < numChildren; childIndex++)
+                    bestPathsOf(childIndex)[layerIndex] = bestPathsOf(childIndex)[layerIndex + 1];
             }
         }
     }
 }
 
-std::shared_ptr<GRTreeNode> PatternRoute::getRoutingTree(std::shared_ptr<PatternRoutingNode>& node, int parentLayerIndex) {
+void PatternRoute::assignLayersLinear(int node, const utils::IntervalT<int>& fixedLayers) {
+    // The via stack of the node spans [low, high] with low <= min(layer, fixedLayers.low) and
+    // high >= max(layer, fixedLayers.high), where layer is the layer towards the parent, and every child takes its
+    // cheapest layer within the stack. With a single child, the stack only depends on the child's layer l:
+    //   l < low:          childCost[l] - viaCosts[l] + viaCosts[high]
+    //   low <= l <= high: childCost[l] + viaCosts[high] - viaCosts[low]
+    //   l > high:         childCost[l] + viaCosts[l] - viaCosts[low]
+    // so running minima upwards and downwards over the layers give every node layer in O(1). Ties go to the lower
+    // layer. The running minima compare childCost[l] -/+ viaCosts[l] rather than the rounded stack costs, so a
+    // candidate within rounding of another may win where the pairwise assignment picks the other one. With several
+    // children, the cheapest stack no longer follows from one child layer, so those nodes use the pairwise assignment.
+    const int numLayers = gridGraph.getNumLayers();
+    const vector<int>& groups = dag.groupScratch;
+    const int numChildren = groups.size();
+    if (numChildren > 1) {
+        assignLayersQuadratic(node, fixedLayers);
+        return;
+    }
+    const vector<std::pair<CostT, int>>& childCosts = dag.childCostScratch;
+    const vector<CostT>& viaCosts = dag.viaCostScratch;
+    const CostT infinity = std::numeric_limits<CostT>::max();
+    CostT* nodeCosts = dag.costs.data() + (size_t)node * numLayers;
+    std::fill(nodeCosts, nodeCosts + numLayers, infinity);
+    auto bestPathsOf = [&](int childIndex) { return dag.bestPaths.data() + (size_t)groups[childIndex] * numLayers; };
+    for (int childIndex = 0; childIndex < numChildren; childIndex++) {
+        std::fill(bestPathsOf(childIndex), bestPathsOf(childIndex) + numLayers, std::make_pair(-1, -1));
+    }
+    auto lowOf = [&](int layerIndex) { return min(layerIndex, fixedLayers.low); };
+    auto highOf = [&](int layerIndex) { return max(layerIndex, fixedLayers.high); };
+
+    if (numChildren == 0) {
+        for (int layerIndex = 0; layerIndex < numLayers; layerIndex++)
+            nodeCosts[layerIndex] = viaCosts[highOf(layerIndex)] - viaCosts[lowOf(layerIndex)];
+        return;
+    }
+
+    using Minimum = std::pair<CostT, int>;  // (value, child layer), child layer -1 if there is none
+    const Minimum none(infinity, -1);
+    auto at = [&](int layerIndex) {
+        return childCosts[layerIndex].second == -1 ? none : Minimum(childCosts[layerIndex].first, layerIndex);
+    };
+    auto better = [](const Minimum& lhs, const Minimum& rhs) {
+        return lhs.second != -1 && (rhs.second == -1 || lhs.first < rhs.first);
+    };
+    vector<Minimum>& up = dag.upMinimumScratch;       // up[l]: childCost over [fixedLayers.low, l]
+    vector<Minimum>& down = dag.downMinimumScratch;   // down[l]: childCost over [l, fixedLayers.high]
+    vector<Minimum>& below = dag.belowMinimumScratch; // below[l]: childCost - viaCosts over [0, l]
+    vector<Minimum>& above = dag.aboveMinimumScratch; // above[l]: childCost + viaCosts over [l, numLayers)
+    up.assign(numLayers, none);
+    down.assign(numLayers, none);
+    below.assign(numLayers, none);
+    above.assign(numLayers, none);
+    Minimum upRunning = none, belowRunning = none;
+    for (int layerIndex = 0; layerIndex < numLayers; layerIndex++) {
+        const Minimum here = at(layerIndex);
+        if (layerIndex >= fixedLayers.low && better(here, upRunning))
+            upRunning = here;
+        up[layerIndex] = upRunning;
+        const Minimum shifted(here.first - viaCosts[layerIndex], here.second);
+        if (better(shifted, belowRunning))
+            belowRunning = shifted;
+        below[layerIndex] = belowRunning;
+    }
+    Minimum downRunning = none, aboveRunning = none;
+    for (int layerIndex = numLayers - 1; layerIndex >= 0; layerIndex--) {
+        const Minimum here = at(layerIndex);
+        if (layerIndex <= fixedLayers.high && !better(downRunning, here))
+            downRunning = here;
+        down[layerIndex] = downRunning;
+        const Minimum shifted(here.first + viaCosts[layerIndex], here.second);
+        if (!better(aboveRunning, shifted))
+            aboveRunning = shifted;
+        above[layerIndex] = aboveRunning;
+    }
+
+    for (int layerIndex = 0; layerIndex < numLayers; layerIndex++) {
+        const int low = lowOf(layerIndex), high = highOf(layerIndex);
+        // Candidates in the order of their stacks (low first, then high), each replaced only by a cheaper one. Keys
+        // use the same expression as the pairwise assignment, so that the costs match to the last bit.
+        auto stackCost = [&](int childLayer) {
+            return (viaCosts[max(high, childLayer)] - viaCosts[min(low, childLayer)]) + childCosts[childLayer].first;
+        };
+        Minimum best = none;
+        CostT bestKey = infinity;
+        if (low > 0 && below[low - 1].second != -1) {
+            best = below[low - 1];
+            bestKey = stackCost(best.second);
+        }
+        // [low, high] is [low, layer] and [layer, high]
+        Minimum inside = layerIndex <= fixedLayers.low ? at(layerIndex) : up[layerIndex];
+        const Minimum upper = layerIndex >= fixedLayers.high ? at(layerIndex) : down[layerIndex];
+        if (better(upper, inside))
+            inside = upper;
+        if (inside.second != -1 && (best.second == -1 || stackCost(inside.second) < bestKey)) {
+            best = inside;
+            bestKey = stackCost(inside.second);
+        }
+        if (high + 1 < numLayers && above[high + 1].second != -1 && (best.second == -1 || stackCost(above[high + 1].second) < bestKey))
+            best = above[high + 1];
+        if (best.second == -1)
+            continue;
+        const int childLayer = best.second;
+        nodeCosts[layerIndex] = stackCost(childLayer);
+        bestPathsOf(0)[layerIndex] = std::make_pair(childCosts[childLayer].second, childLayer);
+    }
+}
+
+void PatternRoute::getRoutingTree(GRTree& tree, int node, int parentLayerIndex, int parent) {
+    const int numLayers = gridGraph.getNumLayers();
     if (parentLayerIndex == -1) {
         CostT minCost = std::numeric_limits<CostT>::max();
-        for (int layerIndex = 0; layerIndex < gridGraph.getNumLayers(); layerIndex++) {
-            if (routingDag->costs[layerIndex] < minCost) {
-                minCost = routingDag->costs[layerIndex];
+        const CostT* rootCosts = dag.costs.data() + (size_t)routingDag * numLayers;
+        for (int layerIndex = 0; layerIndex < numLayers; layerIndex++) {
+            if (rootCosts[layerIndex] < minCost) {
+                minCost = rootCosts[layerIndex];
                 parentLayerIndex = layerIndex;
             }
         }
     }
-    std::shared_ptr<GRTreeNode> routingNode = std::make_shared<GRTreeNode>(parentLayerIndex, node->x, node->y);
-    std::shared_ptr<GRTreeNode> lowestRoutingNode = routingNode;
-    std::shared_ptr<GRTreeNode> highestRoutingNode = routingNode;
-    if (node->paths.size() > 0) {
-        int pathIndex, layerIndex;
-        vector<vector<std::shared_ptr<PatternRoutingNode>>> pathsOnLayer(gridGraph.getNumLayers());
-        for (int childIndex = 0; childIndex < node->paths.size(); childIndex++) {
-            std::tie(pathIndex, layerIndex) = node->bestPaths[parentLayerIndex][childIndex];  // tie is used to unpack the tuple
-            pathsOnLayer[layerIndex].push_back(node->paths[childIndex][pathIndex]);
-        }
-        if (pathsOnLayer[parentLayerIndex].size() > 0) {
-            for (auto& path : pathsOnLayer[parentLayerIndex]) {
-                routingNode->children.push_back(getRoutingTree(path, parentLayerIndex));
-            }
+    const PatternRoutingNode& dagNode = dag.nodes[node];
+    // Paths on other layers hang below chains of via nodes going down and up from routingNode. A chain node is
+    // closed once the chain is complete, since the rest of the chain lies in its subtree.
+    const int routingNode = tree.addNode(GRPoint(parentLayerIndex, dagNode.x, dagNode.y), parent);
+    int lowestRoutingNode = routingNode;
+    int highestRoutingNode = routingNode;
+    if (dagNode.numPathGroups > 0) {
+        vector<vector<int>> pathsOnLayer(numLayers);
+        dag.forEachPathGroup(node, [&](int group) {
+            int path, layerIndex;
+            std::tie(path, layerIndex) = dag.bestPaths[(size_t)group * numLayers + parentLayerIndex];  // tie is used to unpack the tuple
+            pathsOnLayer[layerIndex].push_back(path);
+        });
+        for (int path : pathsOnLayer[parentLayerIndex]) {
+            getRoutingTree(tree, path, parentLayerIndex, routingNode);
         }
+        vector<int> chain;
         for (int layerIndex = parentLayerIndex - 1; layerIndex >= 0; layerIndex--) {
             if (pathsOnLayer[layerIndex].size() > 0) {
-                lowestRoutingNode->children.push_back(std::make_shared<GRTreeNode>(layerIndex, node->x, node->y));
-                lowestRoutingNode = lowestRoutingNode->children.back();
-                for (auto& path : pathsOnLayer[layerIndex]) {
-                    lowestRoutingNode->children.push_back(getRoutingTree(path, layerIndex));
+                lowestRoutingNode = tree.addNode(GRPoint(layerIndex, dagNode.x, dagNode.y), lowestRoutingNode);
+                chain.push_back(lowestRoutingNode);
+                for (int path : pathsOnLayer[layerIndex]) {
+                    getRoutingTree(tree, path, layerIndex, lowestRoutingNode);
                 }
             }
         }
-        for (int layerIndex = parentLayerIndex + 1; layerIndex < gridGraph.getNumLayers(); layerIndex++) {
+        if (lowestRoutingNode != routingNode && tree[lowestRoutingNode].layerIdx > dagNode.fixedLayers.low) {
+            tree.closeNode(tree.addNode(GRPoint(dagNode.fixedLayers.low, dagNode.x, dagNode.y), lowestRoutingNode));
+        }
+        for (int chainNode : chain) tree.closeNode(chainNode);
+        chain.clear();
+        for (int layerIndex = parentLayerIndex + 1; layerIndex < numLayers; layerIndex++) {
             if (pathsOnLayer[layerIndex].size() > 0) {
-                highestRoutingNode->children.push_back(std::make_shared<GRTreeNode>(layerIndex, node->x, node->y));
-                highestRoutingNode = highestRoutingNode->children.back();
-                for (auto& path : pathsOnLayer[layerIndex]) {
-                    highestRoutingNode->children.push_back(getRoutingTree(path, layerIndex));
+                highestRoutingNode = tree.addNode(GRPoint(layerIndex, dagNode.x, dagNode.y), highestRoutingNode);
+                chain.push_back(highestRoutingNode);
+                for (int path : pathsOnLayer[layerIndex]) {
+                    getRoutingTree(tree, path, layerIndex, highestRoutingNode);
                 }
             }
         }
+        if (highestRoutingNode != routingNode && tree[highestRoutingNode].layerIdx < dagNode.fixedLayers.high) {
+            tree.closeNode(tree.addNode(GRPoint(dagNode.fixedLayers.high, dagNode.x, dagNode.y), highestRoutingNode));
+        }
+        for (int chainNode : chain) tree.closeNode(chainNode);
     }
-    if (lowestRoutingNode->layerIdx > node->fixedLayers.low) {
-        lowestRoutingNode->children.push_back(std::make_shared<GRTreeNode>(node->fixedLayers.low, node->x, node->y));
+    // Pin layers beyond routingNode itself come after both chains
+    if (lowestRoutingNode == routingNode && parentLayerIndex > dagNode.fixedLayers.low) {
+        tree.closeNode(tree.addNode(GRPoint(dagNode.fixedLayers.low, dagNode.x, dagNode.y), routingNode));
     }
-    if (highestRoutingNode->layerIdx < node->fixedLayers.high) {
-        highestRoutingNode->children.push_back(std::make_shared<GRTreeNode>(node->fixedLayers.high, node->x, node->y));
+    if (highestRoutingNode == routingNode && parentLayerIndex < dagNode.fixedLayers.high) {
+        tree.closeNode(tree.addNode(GRPoint(dagNode.fixedLayers.high, dagNode.x, dagNode.y), routingNode));
     }
-
-    return routingNode;
+    tree.closeNode(routingNode);
 }
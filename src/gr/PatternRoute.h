@@ -2,9 +2,12 @@
 #include "../flute/flute.h"
 #include "../global.h"
 #include "GRNet.h"
+#include "FlatTree.h"
+#include "FluteCache.h"
 
 extern "C" {
 void readLUT();
+void readLUTFiles(const char *powvfile, const char *postfile);
 Tree flute(int d, DTYPE x[], DTYPE y[], int acc);
 }
 
@@ -27,16 +30,39 @@ class SteinerTreeNode : public utils::PointT<int> {
     // static std::string getPythonString(std::shared_ptr<SteinerTreeNode> node);
 };
 
+// Point of a Steiner tree and the layers that its pins, if any, must reach
+struct SteinerPoint : public utils::PointT<int> {
+    utils::IntervalT<int> fixedLayers;
+    SteinerPoint(utils::PointT<int> point, utils::IntervalT<int> _fixedLayers = utils::IntervalT<int>())
+        : utils::PointT<int>(point), fixedLayers(_fixedLayers) {}
+};
+
+// Steiner tree of a net (see FlatTree). GlobalRouter keeps one per net, built ahead of pattern routing by
+// PatternRoute::constructSteinerTree and tagged with the access points it connects.
+class SteinerTree : public FlatTree<SteinerPoint> {
+   public:
+    SteinerTree() = default;
+    explicit SteinerTree(const std::shared_ptr<SteinerTreeNode>& root);
+
+    inline uint64_t getAccessSignature() const { return accessSignature; }
+
+   private:
+    uint64_t accessSignature = 0;  // hash of the selected access points
+
+    friend class PatternRoute;
+};
+
 class PatternRoutingNode : public utils::PointT<int> {
    public:
-    const int index;
+    int index;
 
-    vector<std::shared_ptr<PatternRoutingNode>> children;
-    vector<vector<std::shared_ptr<PatternRoutingNode>>> paths;  // childIndex -> pathIndex -> path
-    utils::IntervalT<int> fixedLayers;                          // layers that must be visited in order to connect all the pins
-    vector<CostT> costs;                                        // layerIndex -> cost
-    vector<vector<std::pair<int, int>>> bestPaths;              // best path for each child; layerIndex -> childIndex -> (pathIndex, layerIndex)
+    utils::IntervalT<int> fixedLayers;  // layers that must be visited in order to connect all the pins
     bool optional;  // Alan: if this node is optional, it can be skipped if it is not necessary to connect all the pins
+    bool costsReady = false;  // costs and bestPaths of this node have been calculated
+
+    // Lists in PatternRoutingArena: children are links, paths are grouped per child (childIndex -> pathIndex -> path)
+    int firstChild = -1, lastChild = -1, numChildren = 0;
+    int firstPathGroup = -1, lastPathGroup = -1, numPathGroups = 0;
 
     PatternRoutingNode(utils::PointT<int> point, int _index, bool _optional = false)
         : utils::PointT<int>(point), index(_index), optional(_optional) {}
@@ -45,20 +71,142 @@ class PatternRoutingNode : public utils::PointT<int> {
     // static std::string getPythonString(std::shared_ptr<PatternRoutingNode> routingDag);
 };
 
+// Storage of the routing DAG of one net. Nodes refer to each other by index, and children and candidate paths
+// are singly linked lists in shared pools. Every thread owns one arena (local()) that is cleared for each net and
+// keeps its capacity, so building and costing a DAG does not allocate once the pools have grown.
+class PatternRoutingArena {
+   public:
+    struct Link {
+        int node;
+        int next;
+    };
+    struct PathGroup {  // candidate paths towards one child
+        int firstPath = -1;
+        int lastPath = -1;
+        int next = -1;
+    };
+
+    vector<PatternRoutingNode> nodes;
+    vector<PathGroup> pathGroups;
+    vector<Link> links;
+    vector<CostT> costs;                       // costs[node * numLayers + layerIndex]
+    vector<std::pair<int, int>> bestPaths;     // bestPaths[pathGroup * numLayers + layerIndex] -> (path node, layerIndex of the path)
+
+    // Scratch space of PatternRoute::calculateRoutingCosts
+    vector<int> groupScratch;
+    vector<std::pair<CostT, int>> childCostScratch;
+    vector<CostT> minChildCostScratch;
+    vector<std::pair<int, int>> bestPathScratch;
+    vector<CostT> viaCostScratch;
+    vector<CostT> referenceCostScratch;
+    vector<std::pair<int, int>> referencePathScratch;
+    vector<std::pair<CostT, int>> upMinimumScratch;
+    vector<std::pair<CostT, int>> downMinimumScratch;
+    vector<std::pair<CostT, int>> belowMinimumScratch;
+    vector<std::pair<CostT, int>> aboveMinimumScratch;
+
+    static PatternRoutingArena& local() {
+        static thread_local PatternRoutingArena arena;
+        return arena;
+    }
+
+    void clear() {
+        nodes.clear();
+        pathGroups.clear();
+        links.clear();
+    }
+    int addNode(utils::PointT<int> point, bool optional = false) {
+        nodes.emplace_back(point, (int)nodes.size(), optional);
+        return nodes.size() - 1;
+    }
+    int addNode(utils::PointT<int> point, utils::IntervalT<int> fixedLayers) {
+        nodes.emplace_back(point, fixedLayers, (int)nodes.size());
+        return nodes.size() - 1;
+    }
+    void addChild(int node, int child) {
+        append(nodes[node].firstChild, nodes[node].lastChild, child);
+        nodes[node].numChildren++;
+    }
+    int addPathGroup(int node) {
+        const int group = pathGroups.size();
+        pathGroups.emplace_back();
+        PatternRoutingNode& n = nodes[node];
+        if (n.lastPathGroup == -1)
+            n.firstPathGroup = group;
+        else
+            pathGroups[n.lastPathGroup].next = group;
+        n.lastPathGroup = group;
+        n.numPathGroups++;
+        return group;
+    }
+    int getPathGroup(int node, int childIndex) const {
+        int group = nodes[node].firstPathGroup;
+        for (; childIndex > 0; childIndex--)
+            group = pathGroups[group].next;
+        return group;
+    }
+    void addPath(int group, int path) {
+        int first = pathGroups[group].firstPath, last = pathGroups[group].lastPath;
+        append(first, last, path);
+        pathGroups[group].firstPath = first;
+        pathGroups[group].lastPath = last;
+    }
+
+    // The visitors may add nodes and paths; the lists are walked by index
+    template <typename Visit>
+    void forEachChild(int node, Visit visit) const {
+        for (int link = nodes[node].firstChild; link != -1; link = links[link].next)
+            visit(links[link].node);
+    }
+    template <typename Visit>
+    void forEachPathGroup(int node, Visit visit) const {
+        for (int group = nodes[node].firstPathGroup; group != -1; group = pathGroups[group].next)
+            visit(group);
+    }
+    template <typename Visit>
+    void forEachPath(int group, Visit visit) const {
+        for (int link = pathGroups[group].firstPath; link != -1; link = links[link].next)
+            visit(links[link].node);
+    }
+
+   private:
+    void append(int& first, int& last, int node) {
+        const int link = links.size();
+        links.push_back({node, -1});
+        if (last == -1)
+            first = link;
+        else
+            links[last].next = link;
+        last = link;
+    }
+};
+
 class PatternRoute {
    public:
-    static void readFluteLUT() { readLUT(); };
+    static void readFluteLUT(const std::string& lutDir) {
+        if (lutDir.empty())
+            readLUT();
+        else
+            readLUTFiles((lutDir + "/POWV9.dat").c_str(), (lutDir + "/POST9.dat").c_str());
+    };
 
+    // Uses the arena of the calling thread, so only one PatternRoute per thread may be alive at a time
     PatternRoute(GRNet& _net, const GridGraph& graph, const Parameters& param)
-        : net(_net), gridGraph(graph), parameters(param), numDagNodes(0) {}
-    void constructSteinerTree();
+        : net(_net), gridGraph(graph), parameters(param), dag(PatternRoutingArena::local()) {
+        dag.clear();
+    }
+    // Selects the access points of the net and builds its Steiner tree into tree, unless tree already connects the
+    // same access points. Returns whether the tree was (re)built. Thread-safe.
+    static bool constructSteinerTree(const GRNet& net, const GridGraph& gridGraph, SteinerTree& tree, FluteCache* fluteCache = nullptr);
     void constructRoutingDAG();
     void constructDetours(GridGraphView<bool>& congestionView);
     void run();
-    void setSteinerTree(std::shared_ptr<SteinerTreeNode> tree) { steinerTree = tree; }
+    void setSteinerTree(const SteinerTree& tree) { steinerTree = &tree; }  // must outlive the PatternRoute
     // added by Alan
     void getAllAccessPoints();
-    void pruneRoutingTree(std::shared_ptr<GRTreeNode> &node);
+    // Copies tree into pruned without the leaves away from any access point, moving the other leaves to the highest
+    // access point layer of their gcell and merging the nodes that repeat their parent
+    void pruneRoutingTree(const GRTree& tree, GRTree& pruned) const;
     // for net extraction
     void extractNet(std::vector<std::pair<Point, Point> >& extracted_nets, int x_bound, int y_bound);
 
@@ -66,13 +214,22 @@ class PatternRoute {
     const Parameters& parameters;
     const GridGraph& gridGraph;
     GRNet& net;
-    int numDagNodes;
-    std::shared_ptr<SteinerTreeNode> steinerTree;
-    std::shared_ptr<PatternRoutingNode> routingDag;
+    PatternRoutingArena& dag;
+    const SteinerTree* steinerTree = nullptr;
+    int routingDag = -1;  // root node in dag
     // added by Alan
     vector<GRPoint> allAccessPoints;
 
-    void constructPaths(std::shared_ptr<PatternRoutingNode>& start, std::shared_ptr<PatternRoutingNode>& end, int childIndex = -1);
-    void calculateRoutingCosts(std::shared_ptr<PatternRoutingNode>& node);
-    std::shared_ptr<GRTreeNode> getRoutingTree(std::shared_ptr<PatternRoutingNode>& node, int parentLayerIndex = -1);
+    inline int getNumDagNodes() const { return dag.nodes.size(); }
+    void constructPaths(int start, int end, int childIndex = -1);
+    void calculateRoutingCosts(int node);
+    // Layer assignment of calculateRoutingCosts from the child and via costs in the scratch space of the arena.
+    // assignLayersQuadratic tries every (low, high) via stack: O(L^2 x children). assignLayersLinear is O(L) for nodes
+    // with at most one child and falls back to assignLayersQuadratic otherwise. Its sums are rounded in a different
+    // order, so near-ties may pick another layer or differ in the last bit (see Parameters::check_layer_dp).
+    void assignLayersQuadratic(int node, const utils::IntervalT<int>& fixedLayers);
+    void assignLayersLinear(int node, const utils::IntervalT<int>& fixedLayers);
+    // Appends the routing tree of the DAG below node, entered on parentLayerIndex (-1: the cheapest root layer), to
+    // tree as a child of parent
+    void getRoutingTree(GRTree& tree, int node, int parentLayerIndex = -1, int parent = -1);
 };
@@ -0,0 +1,45 @@
+#include "ViaCostCache.h"
+#include "GridGraph.h"
+
+void ViaCostCache::init(const GridGraph& gridGraph) {
+    numLayers = gridGraph.getNumLayers();
+    ySize = gridGraph.getSize(1);
+    const size_t numCells = (size_t)gridGraph.getSize(0) * ySize;
+    states.reset(new std::atomic<uint32_t>[numCells]());
+    prefix.reset(new std::atomic<CostT>[numCells * numLayers]());
+}
+
+void ViaCostCache::query(const GridGraph& gridGraph, const utils::PointT<int> loc, CostT* viaCosts) const {
+    const size_t cell = (size_t)loc.x * ySize + loc.y;
+    std::atomic<uint32_t>& state = states[cell];
+    std::atomic<CostT>* cached = prefix.get() + cell * numLayers;
+    uint32_t before = state.load(std::memory_order_acquire);
+    if ((before & StateMask) == Full) {
+        for (unsigned l = 0; l < numLayers; l++) viaCosts[l] = cached[l].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (state.load(std::memory_order_relaxed) == before)
+            return;
+    }
+
+    auto compute = [&]() {
+        viaCosts[0] = 0;
+        for (unsigned l = 1; l < numLayers; l++) viaCosts[l] = viaCosts[l - 1] + gridGraph.getViaCost(l - 1, loc);
+    };
+    if ((before & StateMask) != Empty || !state.compare_exchange_strong(before, before | Filling, std::memory_order_acquire)) {
+        compute();
+        return;
+    }
+    compute();
+    for (unsigned l = 0; l < numLayers; l++) cached[l].store(viaCosts[l], std::memory_order_relaxed);
+    // Fails if the gcell was invalidated while its costs were computed, which leaves it empty
+    uint32_t filling = before | Filling;
+    state.compare_exchange_strong(filling, before | Full, std::memory_order_release);
+}
+
+void ViaCostCache::invalidate(const int x, const int y) {
+    // Also when empty, so that a thread filling the gcell concurrently does not mark its costs as valid
+    std::atomic<uint32_t>& state = states[(size_t)x * ySize + y];
+    uint32_t current = state.load(std::memory_order_relaxed);
+    while (!state.compare_exchange_weak(current, (current & ~StateMask) + Generation, std::memory_order_acq_rel)) {
+    }
+}
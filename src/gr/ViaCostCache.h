@@ -0,0 +1,34 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include "../global.h"
+
+class GridGraph;
+
+// Per-gcell prefix sums of the via costs up the layer stack, so that the DAG nodes of all nets at the same gcell
+// (detours in stage 2 create many) share one evaluation of the exp() terms instead of one per node.
+//
+// A gcell is filled on first use and invalidated by GridGraph::commit() and commitWire() when the demand of one of
+// its edges changes. Its state word holds a generation and one of Empty, Filling and Full. Only the thread that
+// moved it from Empty to Filling computes and writes the costs. An invalidation moves it to Empty of the next
+// generation, so a fill that overlaps it is dropped. Readers check the word before and after copying the costs,
+// like a sequence lock.
+class ViaCostCache {
+public:
+    void init(const GridGraph& gridGraph);
+    inline bool isInitialized() const { return states != nullptr; }
+
+    // viaCosts[l]: cost of the vias from layer 0 up to layer l at loc, as summed from GridGraph::getViaCost
+    void query(const GridGraph& gridGraph, const utils::PointT<int> loc, CostT* viaCosts) const;
+    void invalidate(const int x, const int y);
+
+private:
+    enum State : uint32_t { Empty = 0, Filling = 1, Full = 2 };
+    static constexpr uint32_t StateMask = 3;
+    static constexpr uint32_t Generation = 4;
+
+    unsigned numLayers = 0;
+    unsigned ySize = 0;
+    std::unique_ptr<std::atomic<uint32_t>[]> states;  // states[x * ySize + y]
+    std::unique_ptr<std::atomic<CostT>[]> prefix;     // prefix[(x * ySize + y) * numLayers + l]
+};
@@ -0,0 +1,108 @@
+#include "WireCostCache.h"
+#include "GridGraph.h"
+
+void WireCostCache::init(const GridGraph& gridGraph) {
+    layers.clear();
+    layers.resize(gridGraph.getNumLayers());
+    for (unsigned layerIndex = 0; layerIndex < gridGraph.getNumLayers(); layerIndex++) {
+        const unsigned direction = gridGraph.getLayerDirection(layerIndex);
+        LayerCache& layer = layers[layerIndex];
+        layer.numTracks = gridGraph.getSize(1 - direction);
+        layer.trackLength = gridGraph.getSize(direction);
+        layer.prefix.reset(new std::atomic<uint64_t>[(size_t)layer.numTracks * layer.trackLength]());
+        layer.capped.reset(new std::atomic<uint32_t>[(size_t)layer.numTracks * layer.trackLength]());
+        layer.versions.reset(new std::atomic<uint32_t>[layer.numTracks]());
+
+        const int numTracks = layer.numTracks;
+        const int numEdges = layer.trackLength - 1;
+#pragma omp parallel for schedule(static)
+        for (int track = 0; track < numTracks; track++) {
+            static thread_local vector<CostT> costs;
+            costs.resize(numEdges);
+            gridGraph.getWireCosts(layerIndex, track, 0, numEdges, costs.data());
+            std::atomic<uint64_t>* prefix = layer.prefix.get() + (size_t)track * layer.trackLength;
+            std::atomic<uint32_t>* capped = layer.capped.get() + (size_t)track * layer.trackLength;
+            uint64_t sum = 0;
+            uint32_t numCapped = 0;
+            prefix[0].store(0, std::memory_order_relaxed);
+            capped[0].store(0, std::memory_order_relaxed);
+            for (int i = 0; i < numEdges; i++) {
+                const uint64_t cost = quantize(costs[i]);
+                sum += cost;
+                numCapped += cost == MaxEdgeCost;
+                prefix[i + 1].store(sum, std::memory_order_relaxed);
+                capped[i + 1].store(numCapped, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+bool WireCostCache::query(const int layerIndex, const int track, const int low, const int high, CostT& cost) const {
+    const LayerCache& layer = layers[layerIndex];
+    assert(low <= high && high < (int)layer.trackLength);
+    const size_t offset = (size_t)track * layer.trackLength;
+    const std::atomic<uint64_t>* prefix = layer.prefix.get() + offset;
+    const std::atomic<uint32_t>* capped = layer.capped.get() + offset;
+    const std::atomic<uint32_t>& version = layer.versions[track];
+    uint64_t sum;
+    uint32_t numCapped;
+    while (true) {
+        uint32_t before = version.load(std::memory_order_acquire);
+        if (before & 1) continue;  // a writer is updating the track
+        sum = prefix[high].load(std::memory_order_relaxed) - prefix[low].load(std::memory_order_relaxed);
+        numCapped = capped[high].load(std::memory_order_relaxed) - capped[low].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (version.load(std::memory_order_relaxed) == before) break;
+    }
+    if (numCapped != 0)
+        return false;
+    cost = sum / Scale;
+    return true;
+}
+
+void WireCostCache::update(const GridGraph& gridGraph, const int layerIndex, const int track, const int low, const int high) {
+    LayerCache& layer = layers[layerIndex];
+    const int end = min(high, (int)layer.trackLength - 1);
+    if (low >= end) return;
+    std::atomic<uint64_t>* prefix = layer.prefix.get() + (size_t)track * layer.trackLength;
+    std::atomic<uint32_t>* capped = layer.capped.get() + (size_t)track * layer.trackLength;
+    std::atomic<uint32_t>& version = layer.versions[track];
+    static thread_local vector<CostT> costs;
+    costs.resize(end - low);
+    gridGraph.getWireCosts(layerIndex, track, low, end, costs.data());
+
+    uint32_t current = version.load(std::memory_order_relaxed);
+    while ((current & 1) || !version.compare_exchange_weak(current, current + 1, std::memory_order_acquire)) {
+        current = version.load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);  // readers must not see new sums with the old version
+
+    // Only the writer holding the lock modifies the track, so relaxed read-modify-write is sufficient
+    uint64_t delta = 0;
+    uint32_t cappedDelta = 0;
+    uint64_t previous = prefix[low].load(std::memory_order_relaxed);
+    uint32_t previousCapped = capped[low].load(std::memory_order_relaxed);
+    for (int i = low; i < end; i++) {
+        const uint64_t next = prefix[i + 1].load(std::memory_order_relaxed);
+        const uint32_t nextCapped = capped[i + 1].load(std::memory_order_relaxed);
+        const uint64_t cost = quantize(costs[i - low]);
+        delta += cost - (next - previous);
+        cappedDelta += uint32_t(cost == MaxEdgeCost) - (nextCapped - previousCapped);
+        previous = next;
+        previousCapped = nextCapped;
+        prefix[i + 1].store(next + delta, std::memory_order_relaxed);
+        capped[i + 1].store(nextCapped + cappedDelta, std::memory_order_relaxed);
+    }
+    if (delta != 0 || cappedDelta != 0) {
+        for (unsigned i = end + 1; i < layer.trackLength; i++) {
+            prefix[i].store(prefix[i].load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+            capped[i].store(capped[i].load(std::memory_order_relaxed) + cappedDelta, std::memory_order_relaxed);
+        }
+    }
+
+    version.store(current + 2, std::memory_order_release);
+}
+
+bool WireCostCache::matches(const CostT cached, const CostT exact, const int numEdges) {
+    return std::abs(cached - exact) <= numEdges * 0.5 / Scale + 1e-9 * exact;
+}
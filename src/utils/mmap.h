@@ -0,0 +1,83 @@
+//
+// Read-only memory mapping of a whole file.
+// The mapped bytes stay valid for the lifetime of the MappedFile object, so string_views
+// and pointers into data() may be kept around as long as the object itself is kept alive.
+//
+
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+namespace utils {
+
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& filename) { open(filename); }
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            close();
+            std::swap(_data, other._data);
+            std::swap(_size, other._size);
+            std::swap(_open, other._open);
+        }
+        return *this;
+    }
+
+    bool open(const std::string& filename) {
+        close();
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+        _size = static_cast<size_t>(st.st_size);
+        if (_size > 0) {
+            void* addr = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                ::close(fd);
+                _size = 0;
+                return false;
+            }
+            madvise(addr, _size, MADV_WILLNEED);
+            _data = static_cast<const char*>(addr);
+        }
+        ::close(fd);  // the mapping keeps its own reference to the file
+        _open = true;
+        return true;
+    }
+
+    void close() {
+        if (_data) munmap(const_cast<char*>(_data), _size);
+        _data = nullptr;
+        _size = 0;
+        _open = false;
+    }
+
+    bool isOpen() const { return _open; }
+    const char* data() const { return _data; }
+    const char* begin() const { return _data; }
+    const char* end() const { return _data + _size; }
+    size_t size() const { return _size; }
+
+private:
+    const char* _data = nullptr;
+    size_t _size = 0;
+    bool _open = false;
+};
+
+}  // namespace utils
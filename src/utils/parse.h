@@ -0,0 +1,143 @@
+//
+// Allocation-free number parsing over [p, end) character ranges (e.g. memory-mapped files).
+// Every parser skips leading whitespace, advances p past the parsed token and returns false
+// if no number could be read.
+//
+// parseDouble() takes Clinger's fast path: when the decimal mantissa fits in 53 bits and the
+// decimal exponent is within [-22, 22], a single IEEE multiplication or division by an exact
+// power of ten is correctly rounded. Anything else falls back to strtod(), so the result is
+// always bit-identical to what fscanf("%lf") produces.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace utils {
+
+inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f'; }
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+inline const char* skipSpaces(const char* p, const char* end) {
+    while (p < end && isSpace(*p)) ++p;
+    return p;
+}
+
+inline const char* skipToken(const char* p, const char* end) {
+    while (p < end && !isSpace(*p)) ++p;
+    return p;
+}
+
+// Returns the beginning of the next line (or end)
+inline const char* skipLine(const char* p, const char* end) {
+    const void* newline = memchr(p, '\n', end - p);
+    return newline ? static_cast<const char*>(newline) + 1 : end;
+}
+
+// Returns the position of the next '\n' (or end)
+inline const char* findLineEnd(const char* p, const char* end) {
+    const void* newline = memchr(p, '\n', end - p);
+    return newline ? static_cast<const char*>(newline) : end;
+}
+
+inline bool parseInt(const char*& p, const char* end, int& value) {
+    p = skipSpaces(p, end);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+    if (p >= end || !isDigit(*p)) return false;
+    int64_t result = 0;
+    for (; p < end && isDigit(*p); ++p) result = result * 10 + (*p - '0');
+    value = static_cast<int>(negative ? -result : result);
+    return true;
+}
+
+inline bool parseDouble(const char*& p, const char* end, double& value) {
+    static const double powersOf10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                        1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                        1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    p = skipSpaces(p, end);
+    const char* start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int numDigits = 0;  // significant digits held in mantissa
+    int exponent = 0;
+    bool inexact = false;
+    bool anyDigit = false;
+    for (; p < end && isDigit(*p); ++p) {
+        anyDigit = true;
+        if (numDigits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa) ++numDigits;
+        } else {
+            ++exponent;
+            inexact |= *p != '0';
+        }
+    }
+    if (p < end && *p == '.') {
+        ++p;
+        for (; p < end && isDigit(*p); ++p) {
+            anyDigit = true;
+            if (numDigits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa) ++numDigits;
+                --exponent;
+            } else {
+                inexact |= *p != '0';
+            }
+        }
+    }
+    if (!anyDigit) {
+        // inf, nan, hexadecimal, ... are left to the C library
+        p = start;
+        char* parsedEnd = nullptr;
+        char buffer[64];
+        size_t length = skipToken(start, end) - start;
+        if (length == 0 || length >= sizeof(buffer)) return false;
+        memcpy(buffer, start, length);
+        buffer[length] = '\0';
+        value = strtod(buffer, &parsedEnd);
+        if (parsedEnd == buffer) return false;
+        p = start + (parsedEnd - buffer);
+        return true;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        int exponentValue = 0;
+        if (parseInt(q, end, exponentValue) && q > p + 1 && !isSpace(p[1])) {
+            exponent += exponentValue;
+            p = q;
+        }
+    }
+
+    if (!inexact && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+        double result = static_cast<double>(mantissa);
+        result = exponent < 0 ? result / powersOf10[-exponent] : result * powersOf10[exponent];
+        value = negative ? -result : result;
+        return true;
+    }
+
+    char buffer[128];
+    size_t length = p - start;
+    if (length < sizeof(buffer)) {
+        memcpy(buffer, start, length);
+        buffer[length] = '\0';
+        value = strtod(buffer, nullptr);
+    } else {
+        std::string token(start, length);
+        value = strtod(token.c_str(), nullptr);
+    }
+    return true;
+}
+
+}  // namespace utils